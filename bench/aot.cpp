@@ -0,0 +1,55 @@
+// Runs scripts/geometry.gs through the VM, with and without the JIT, and as the
+// C++ that GUISE_ADD_AOT translated it to at build time.
+
+#include "geometry.h"
+
+#include <guise/compiler/compiler.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/vm.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using namespace GuiSE;
+
+namespace {
+template <typename F> double time(int iterations, F f) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    f();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double run_vm(const ByteCode &byte_code, int iterations, bool jit) {
+  VM vm;
+  vm.set_jit_enabled(jit);
+  vm.set_byte_code(byte_code);
+  vm.RunGlobal();
+  return time(iterations, [&vm] { vm.Call("main"); });
+}
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  const int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+
+  std::ifstream file(GUISE_BENCH_SCRIPT);
+  std::stringstream ss;
+  ss << file.rdbuf();
+  ByteCode byte_code;
+  if (!compile(ss.str().c_str(), byte_code))
+    return 1;
+
+  geometry::init();
+  const double aot_ms = time(iterations, [] { geometry::main(); });
+
+  printf("%d iterations, result %g\n", iterations, geometry::globals.result);
+  printf("%-10s %10.2f ms\n", "vm", run_vm(byte_code, iterations, false));
+  printf("%-10s %10.2f ms\n", "jit", run_vm(byte_code, iterations, true));
+  printf("%-10s %10.2f ms\n", "aot", aot_ms);
+  return 0;
+}
@@ -0,0 +1,139 @@
+// Runs layout and fits from scripts/geometry.gs, or the functions named after
+// another script, over many rows, one VM::Call per row, with and without the
+// JIT, against one VM::CallBatch over them all. Exits non-zero if either
+// gives other results than the interpreter, so a small run doubles as a test.
+
+#include <guise/compiler/compiler.h>
+#include <guise/vm/batch.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/vm.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+using namespace GuiSE;
+
+namespace {
+template <typename F> double time(F f) {
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+struct Rows {
+  std::vector<std::vector<Num>> columns;
+  std::vector<const Num *> args;
+};
+
+// Mostly ordinary values, with a zero, negative zero or infinity every few
+// rows so NaNs and signed zeros reach the compares.
+Rows make_rows(size_t arity, size_t rows) {
+  static const Num special[] = {0.0, -0.0, INFINITY, -INFINITY};
+  Rows result;
+  result.columns.assign(arity, std::vector<Num>(rows));
+  for (size_t p = 0; p < arity; p++) {
+    for (size_t r = 0; r < rows; r++) {
+      result.columns[p][r] = r % 13 == p ? special[r / 13 % 4]
+                                         : 1.0 + (r * (p + 3) % 997) * 0.125;
+    }
+    result.args.push_back(result.columns[p].data());
+  }
+  return result;
+}
+
+double run_rows(const ByteCode &byte_code, int function, const Rows &rows,
+                std::vector<Num> &results, bool jit) {
+  VM vm;
+  vm.set_jit_enabled(jit);
+  vm.set_byte_code(byte_code);
+  vm.RunGlobal();
+  const Function &info = byte_code.GetFunctionInfo(function);
+  return time([&] {
+    std::vector<Value> args(info.arity);
+    Value result;
+    for (size_t r = 0; r < results.size(); r++) {
+      for (size_t p = 0; p < args.size(); p++) {
+        args[p] = rows.args[p][r];
+      }
+      vm.Call(function, args.data(), args.size(), result);
+      results[r] = info.return_type == ValueType::Bool ? result.bool_
+                                                         : result.num;
+    }
+  });
+}
+
+bool bench(const ByteCode &byte_code, const char *name, size_t row_count) {
+  const int function = byte_code.FindFunction(name);
+  if (function == -1) {
+    printf("%s does not exist\n", name);
+    return false;
+  }
+  const Rows rows = make_rows(byte_code.GetFunctionInfo(function).arity,
+                              row_count);
+  std::vector<Num> vm_results(row_count);
+  std::vector<Num> jit_results(row_count);
+  std::vector<Num> batch_results(row_count);
+
+  const double vm_ms = run_rows(byte_code, function, rows, vm_results, false);
+  const double jit_ms = run_rows(byte_code, function, rows, jit_results, true);
+  VM vm;
+  vm.set_byte_code(byte_code);
+  vm.RunGlobal();
+  InterpretResult status = InterpretResult::Ok;
+  const double batch_ms = time([&] {
+    status = vm.CallBatch(function, rows.args.data(), row_count,
+                          batch_results.data());
+  });
+  if (status != InterpretResult::Ok) {
+    printf("%s cannot run batched\n", name);
+    return false;
+  }
+
+  const bool jit_same = memcmp(vm_results.data(), jit_results.data(),
+                               row_count * sizeof(Num)) == 0;
+  const bool batch_same = memcmp(vm_results.data(), batch_results.data(),
+                                 row_count * sizeof(Num)) == 0;
+  printf("%s%s%s\n", name, jit_same ? "" : " (jit results differ)",
+         batch_same ? "" : " (batch results differ)");
+  printf("  %-10s %10.2f ms\n", "vm", vm_ms);
+  printf("  %-10s %10.2f ms\n", "jit", jit_ms);
+  printf("  %-10s %10.2f ms %8.1fx vm\n", "batch", batch_ms,
+         vm_ms / batch_ms);
+  return jit_same && batch_same;
+}
+} // namespace
+
+// GuiSE_bench_batch [rows [script function...]]
+int main(int argc, const char *argv[]) {
+  const int rows = argc > 1 ? atoi(argv[1]) : 1000000;
+  if (rows <= 0) {
+    printf("rows must be positive\n");
+    return 1;
+  }
+  const char *script = argc > 2 ? argv[2] : GUISE_BENCH_SCRIPT;
+  std::vector<const char *> functions(argv + std::min(argc, 3), argv + argc);
+  if (argc <= 2)
+    functions = {"layout", "fits"};
+
+  std::ifstream file(script);
+  std::stringstream ss;
+  ss << file.rdbuf();
+  ByteCode byte_code;
+  if (!compile(ss.str().c_str(), byte_code))
+    return 1;
+
+  printf("%d rows, %s kernels\n", rows, batch_isa());
+  bool same = true;
+  for (const char *function : functions) {
+    same &= bench(byte_code, function, rows);
+  }
+  return same ? 0 : 1;
+}
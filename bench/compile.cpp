@@ -0,0 +1,294 @@
+// Compiles a generated program of a chosen shape and reports each compile
+// phase in MiB/s and tokens/s, with the peak resident memory, as a table or,
+// with --json, as one JSON object to compare between releases.
+//
+//   GuiSE_bench_compile [functions] [globals] [depth] [id_length] [runs]
+//                       [--json]
+//
+// Identifier lengths are drawn evenly from 1 to 2 * id_length - 1, so they
+// average id_length, except that a name whose length has run out of names
+// takes the next length that has not, which only happens to the shortest
+// few. Every setting must be positive. Scanning and
+// compiling are timed on their own; the parser emits code as it parses, so
+// parse and emit is the compile time less the scan time. The peephole pass
+// and image writing, which emit the final byte code and its file, follow.
+
+#include <guise/compiler/compiler.h>
+#include <guise/compiler/optimizer.h>
+#include <guise/compiler/scanner.h>
+#include <guise/compiler/symbol.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace GuiSE;
+
+namespace {
+struct Shape {
+  int functions = 5000;
+  int globals = 1000;
+  int depth = 3;     // of the binary expression trees
+  int id_length = 8; // mean identifier length
+};
+
+// Builds a program of the given shape. A name's length is drawn first, then
+// the names of that length are counted off in order, the first char an upper
+// case letter, so never a keyword, and the rest letters or digits. Literals are small whole numbers, which are
+// encoded inline, so only folded subexpressions take constants.
+class Generator {
+public:
+  explicit Generator(const Shape &shape) : _shape(shape) {}
+
+  std::string Generate() {
+    std::string source = "# generated for GuiSE_bench_compile\n";
+    for (int i = 0; i < _shape.globals; i++) {
+      const std::string global = _name();
+      source += global + " : num " + _expr(_shape.depth, {}, false) + ";\n";
+      _globals.push_back(global);
+    }
+
+    for (int i = 0; i < _shape.functions; i++) {
+      const std::string function = _name();
+      std::vector<std::string> vars = {_name(), _name()};
+      source += function + " : " + vars[0] + " num : " + vars[1] +
+                " num : fn num {\n";
+      for (int j = 0; j < 2; j++) {
+        const std::string local = _name();
+        source += "  " + local + " : num " +
+                  _expr(_shape.depth, vars, true) + ";\n";
+        vars.push_back(local);
+      }
+      source += "  return " + _expr(_shape.depth, vars, true) + ";\n}\n";
+      _functions.push_back(function);
+    }
+    return source;
+  }
+
+private:
+  int _draw(int count) {
+    return std::uniform_int_distribution<int>(0, count - 1)(_random);
+  }
+
+  std::string _name() {
+    static const char tail[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    const int tail_size = sizeof(tail) - 1;
+    int length = 1 + _draw(2 * _shape.id_length - 1);
+    uint64_t index;
+    for (;; length++) {
+      if (static_cast<size_t>(length) > _names.size())
+        _names.resize(length);
+      // names of this length, saturating well before it could overflow
+      uint64_t count = 26;
+      for (int i = 1; i < length && count < (1ull << 40); i++) {
+        count *= tail_size;
+      }
+      index = _names[length - 1];
+      if (index < count)
+        break;
+    }
+    _names[length - 1]++;
+
+    std::string name(1, 'A' + index % 26);
+    index /= 26;
+    while (static_cast<int>(name.size()) < length) {
+      name += tail[index % tail_size];
+      index /= tail_size;
+    }
+    return name;
+  }
+
+  std::string _leaf(const std::vector<std::string> &vars, bool calls) {
+    const int kind = _draw(20);
+    if (kind < 8 && !vars.empty())
+      return vars[_draw(vars.size())];
+    if (kind < 12 && !_globals.empty())
+      return _globals[_draw(_globals.size())];
+    if (kind < 15 && calls && !_functions.empty()) {
+      return "(" + _functions[_draw(_functions.size())] + " " +
+             _leaf(vars, false) + " " + _leaf(vars, false) + ")";
+    }
+    return std::to_string(1 + _draw(99)) + ".0";
+  }
+
+  std::string _expr(int depth, const std::vector<std::string> &vars,
+                    bool calls) {
+    if (depth == 0)
+      return _leaf(vars, calls);
+    static const char *ops[] = {" + ", " - ", " * ", " / "};
+    return "(" + _expr(depth - 1, vars, calls) + ops[_draw(4)] +
+           _expr(depth - 1, vars, calls) + ")";
+  }
+
+  Shape _shape;
+  std::mt19937 _random{20240601};
+  std::vector<uint64_t> _names; // taken so far, by length - 1
+  std::vector<std::string> _globals;
+  std::vector<std::string> _functions;
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// Best of runs calls of f, in seconds.
+template <typename F> double best(int runs, F f) {
+  double seconds = 1e30;
+  for (int run = 0; run < runs; run++) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    seconds = std::min(seconds, seconds_since(start));
+  }
+  return seconds;
+}
+
+size_t peak_rss_kib() {
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024; // bytes there
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
+struct Phase {
+  const char *name;
+  double seconds;
+
+  // Zero, not infinity, for a phase too short to time, as when noise puts
+  // the compile time below the scan time.
+  double per_second(double amount) const {
+    return seconds > 0 ? amount / seconds : 0;
+  }
+};
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  bool json = false;
+  std::vector<int> numbers;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else {
+      numbers.push_back(atoi(argv[i]));
+    }
+  }
+  Shape shape;
+  int runs = 5;
+  int *settings[] = {&shape.functions, &shape.globals, &shape.depth,
+                     &shape.id_length, &runs};
+  for (size_t i = 0; i < numbers.size() && i < std::size(settings); i++) {
+    *settings[i] = numbers[i];
+  }
+  for (const int *setting : settings) {
+    if (*setting <= 0) {
+      fprintf(stderr, "Every setting must be a positive number.\n");
+      return 1;
+    }
+  }
+
+  const std::string source = Generator(shape).Generate();
+  const double mib = source.size() / double(1 << 20);
+
+  size_t tokens = 0;
+  const double scan = best(runs, [&] {
+    SymbolTable symbols;
+    Scanner scanner(source.data(), source.size(), &symbols);
+    Token token;
+    tokens = 0;
+    for (TokenType type; (type = scanner.ScanToken(token)) != TokenType::Eof;
+         tokens++) {
+      if (type == TokenType::Error) {
+        fprintf(stderr, "scan error at line %d\n", token.line);
+        exit(1);
+      }
+    }
+  });
+
+  CompileOptions options;
+  options.peephole = false;
+  ByteCode byte_code;
+  const double compiled = best(runs, [&] {
+    byte_code = ByteCode();
+    if (!compile(source.data(), source.size(), byte_code, options))
+      exit(1);
+  });
+
+  double peephole = 1e30;
+  for (int run = 0; run < runs; run++) {
+    ByteCode unoptimized;
+    compile(source.data(), source.size(), unoptimized, options);
+    const auto start = std::chrono::steady_clock::now();
+    optimize(unoptimized);
+    peephole = std::min(peephole, seconds_since(start));
+  }
+
+  const uint64_t hash = source_hash(source.data(), source.size());
+  const double image = best(runs, [&] {
+    std::ostringstream out;
+    if (!write_image(byte_code, hash, out))
+      exit(1);
+  });
+
+  const Phase phases[] = {
+      {"scan", scan},
+      {"parse_emit", std::max(0.0, compiled - scan)},
+      {"compile", compiled},
+      {"peephole", peephole},
+      {"image", image},
+  };
+  const size_t rss = peak_rss_kib();
+
+  if (json) {
+    printf("{\"functions\": %d, \"globals\": %d, \"depth\": %d, "
+           "\"id_length\": %d, \"runs\": %d,\n",
+           shape.functions, shape.globals, shape.depth, shape.id_length,
+           runs);
+    printf(" \"source_bytes\": %zu, \"tokens\": %zu, \"code_bytes\": %zu, "
+           "\"peak_rss_kib\": %zu,\n \"phases\": {",
+           source.size(), tokens, byte_code.Length(), rss);
+    for (size_t i = 0; i < std::size(phases); i++) {
+      const Phase &phase = phases[i];
+      printf("%s\n  \"%s\": {\"ms\": %.3f, \"mib_per_s\": %.1f, "
+             "\"mtokens_per_s\": %.2f}",
+             i == 0 ? "" : ",", phase.name, phase.seconds * 1e3,
+             phase.per_second(mib), phase.per_second(tokens) / 1e6);
+    }
+    printf("}}\n");
+    return 0;
+  }
+
+  printf("%d functions, %d globals, depth %d, names of %d chars on average\n",
+         shape.functions, shape.globals, shape.depth, shape.id_length);
+  printf("%.1f MiB, %zu tokens, %zu bytes of code, best of %d\n", mib,
+         tokens, byte_code.Length(), runs);
+  for (const Phase &phase : phases) {
+    printf("%-10s %10.2f ms %8.1f MiB/s %8.2f Mtokens/s\n", phase.name,
+           phase.seconds * 1e3, phase.per_second(mib),
+           phase.per_second(tokens) / 1e6);
+  }
+  printf("%zu KiB peak resident\n", rss);
+  return 0;
+}
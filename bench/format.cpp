@@ -0,0 +1,65 @@
+// Builds GUI labels from formatted values every frame, the way a HUD would,
+// and reports the cost per label for a few kinds of slot.
+
+#include <guise/compiler/compiler.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/vm.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace GuiSE;
+
+namespace {
+const char *source =
+    "unit : str \"ms\";\n"
+    "whole : n num : fn str {\n"
+    "  return fn \"frame {n} of {n * 4.0}\";\n"
+    "}\n"
+    "fraction : n num : fn str {\n"
+    "  return fn \"x {n / 7.0} y {n / 3.0}\";\n"
+    "}\n"
+    "mixed : n num : fn str {\n"
+    "  return fn \"{n > 100.0} {n} {unit}\";\n"
+    "}\n";
+
+void run(VM &vm, const ByteCode &byte_code, const char *name, int frames,
+         int labels) {
+  const int function = byte_code.FindFunction(name);
+  const auto start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < frames; frame++) {
+    for (int i = 0; i < labels; i++) {
+      const Value arg = Num(frame * labels + i);
+      Value result;
+      vm.Call(function, &arg, 1, result);
+    }
+    vm.CollectStep();
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  const double count = static_cast<double>(frames) * labels;
+  printf("%-10s %8.1f ns per label %10.0f labels/s\n", name,
+         seconds * 1e9 / count, count / seconds);
+}
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  const int frames = argc > 1 ? atoi(argv[1]) : 1000;
+  const int labels = argc > 2 ? atoi(argv[2]) : 1000;
+
+  ByteCode byte_code;
+  if (!compile(source, byte_code))
+    return 1;
+  VM vm;
+  vm.set_byte_code(byte_code);
+  vm.RunGlobal();
+
+  printf("%d frames, %d labels each\n", frames, labels);
+  run(vm, byte_code, "whole", frames, labels);
+  run(vm, byte_code, "fraction", frames, labels);
+  run(vm, byte_code, "mixed", frames, labels);
+  printf("%.1f ms max collection pause\n", vm.get_gc_stats().max_pause_ms);
+  return 0;
+}
@@ -0,0 +1,68 @@
+// Simulates GUI frames that each make a batch of strs, most of them garbage
+// at once, and compares collection pauses for a few incremental step budgets
+// against collecting whole cycles at a time.
+
+#include <guise/compiler/compiler.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/heap.h>
+#include <guise/vm/object.h>
+#include <guise/vm/vm.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace GuiSE;
+
+namespace {
+const char *source = "label : str \"start\";\n"
+                     "main : fn {\n"
+                     "  log label;\n"
+                     "}\n";
+
+void run(const char *name, size_t budget, int frames, int strs) {
+  ByteCode byte_code;
+  if (!compile(source, byte_code))
+    exit(1);
+  VM vm;
+  vm.set_byte_code(byte_code);
+  vm.RunGlobal();
+
+  Heap &heap = vm.get_heap();
+  size_t peak = 0;
+  char chars[64];
+  for (int frame = 0; frame < frames; frame++) {
+    Str *label = nullptr;
+    for (int i = 0; i < strs; i++) {
+      const int length =
+          snprintf(chars, sizeof(chars), "frame %d label %d", frame, i);
+      label = heap.NewStr(chars, length);
+    }
+    // only the last label of a frame stays reachable
+    vm.SetGlobal("label", label);
+    vm.CollectStep(budget);
+    peak = std::max(peak, heap.get_bytes());
+  }
+
+  const GcStats &stats = vm.get_gc_stats();
+  printf("%-14s %6llu cycles %8.3f ms max %8.4f ms mean %8.1f KiB peak\n",
+         name, static_cast<unsigned long long>(stats.cycles),
+         stats.max_pause_ms,
+         stats.steps ? stats.total_pause_ms / stats.steps : 0.0,
+         peak / 1024.0);
+}
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  const int frames = argc > 1 ? atoi(argv[1]) : 2000;
+  const int strs = argc > 2 ? atoi(argv[2]) : 2000;
+
+  printf("%d frames, %d strs each\n", frames, strs);
+  run("budget 256", 256, frames, strs);
+  run("budget 1024", 1024, frames, strs);
+  run("budget 4096", 4096, frames, strs);
+  run("whole cycles", SIZE_MAX, frames, strs);
+  return 0;
+}
@@ -0,0 +1,72 @@
+// Compares startup from source, scanning, parsing and compiling a generated
+// script bundle, against loading the same bundle from a binary image.
+
+#include <guise/compiler/compiler.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/image.h>
+#include <guise/vm/vm.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+using namespace GuiSE;
+
+namespace {
+std::string generate(int functions) {
+  std::string source;
+  for (int i = 0; i < functions; i++) {
+    const std::string n = std::to_string(i);
+    source += "f" + n + " : a num : b num : fn num {\n";
+    source += "  x : num a * b + 1.5;\n";
+    source += "  y : num x / b - a * 2.5;\n";
+    source += "  return x * y + a - b / 3.0;\n";
+    source += "}\n";
+  }
+  source += "main : fn {\n  log \"done\";\n}\n";
+  return source;
+}
+
+template <typename F> double time(int iterations, F f) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    f();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() /
+         iterations;
+}
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  const int functions = argc > 1 ? atoi(argv[1]) : 20000;
+  const int iterations = argc > 2 ? atoi(argv[2]) : 10;
+  const char *image_name = "GuiSE_bench_image.gsi";
+  const std::string source = generate(functions);
+
+  ByteCode byte_code;
+  if (!compile(source.c_str(), byte_code))
+    return 1;
+  std::ofstream image(image_name, std::ios::binary);
+  if (!write_image(byte_code, source_hash(source.data(), source.size()),
+                   image))
+    return 1;
+  image.close();
+
+  const double compile_ms = time(iterations, [&source] {
+    ByteCode byte_code;
+    compile(source.c_str(), byte_code);
+  });
+  const double load_ms = time(iterations, [image_name] {
+    ByteCode byte_code;
+    load_image(image_name, byte_code);
+  });
+
+  printf("%d functions, %zu bytes of code\n", functions, byte_code.Length());
+  printf("%-10s %10.3f ms\n", "compile", compile_ms);
+  printf("%-10s %10.3f ms\n", "image", load_ms);
+  std::remove(image_name);
+  return 0;
+}
@@ -0,0 +1,130 @@
+// Compares the stack instruction set against the register forms emitted with
+// CompileOptions::register_ops, and against the peephole superinstruction pass
+// enabled by CompileOptions::peephole. All variants of a generated
+// arithmetic-heavy program are executed, and the instructions dispatched and
+// operand stack pushes and pops are counted by walking the (straight-line)
+// code of main. The last row runs the peephole code with the JIT enabled.
+
+#include <guise/compiler/compiler.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/opcode.h>
+#include <guise/vm/vm.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace GuiSE;
+
+namespace {
+struct Counts {
+  uint64_t instructions = 0;
+  uint64_t pushes = 0;
+  uint64_t pops = 0;
+};
+
+std::string generate(int functions, int statements) {
+  std::string source;
+  for (int i = 0; i < functions; i++) {
+    const std::string n = std::to_string(i);
+    source += "f" + n + " : a num : b num : c num : fn num {\n";
+    source += "  return a * b + c * a - b / c + a * c - b * b;\n";
+    source += "}\n";
+  }
+
+  source += "main : fn {\n";
+  source += "  x : num 1.5;\n  y : num 2.5;\n  z : num 0.5;\n";
+  for (int i = 0; i < statements; i++) {
+    const std::string f = "f" + std::to_string(i % functions);
+    source += "  x = " + f + " x y z + x * y - z / y;\n";
+    source += "  y = x * z + y * y - x / z;\n";
+  }
+  source += "}\n";
+  return source;
+}
+
+// Walks straight-line code from ip to its Return, following calls.
+void count(const ByteCode &byte_code, const uint8_t *ip, Counts &counts) {
+  for (;;) {
+    const OpCode op_code = static_cast<OpCode>(*ip);
+    const OpInfo &info = op_info(op_code);
+    counts.instructions++;
+    counts.pushes += info.pushes;
+
+    switch (op_code) {
+    case OpCode::CallDirect:
+    case OpCode::CallMemo: {
+      const Function &function = byte_code.GetFunctionInfo(ip[1] | ip[2] << 8);
+      count(byte_code, byte_code[function.offset], counts);
+    } break;
+    case OpCode::TailCall: {
+      const Function &function = byte_code.GetFunctionInfo(ip[1] | ip[2] << 8);
+      count(byte_code, byte_code[function.offset], counts);
+    }
+      return;
+    case OpCode::Return:
+    case OpCode::ReturnMemo:
+      counts.pops += info.pops;
+      return;
+    default:
+      counts.pops += info.pops;
+      break;
+    }
+    ip += instruction_length(ip);
+  }
+}
+
+double run(const ByteCode &byte_code, int iterations, bool jit) {
+  VM vm;
+  vm.set_jit_enabled(jit);
+  vm.set_byte_code(byte_code);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    vm.Call("main");
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void report(const char *name, const ByteCode &byte_code, int iterations,
+            bool jit = false) {
+  Counts counts;
+  count(byte_code, byte_code.GetFunction("main"), counts);
+  const double ms = run(byte_code, iterations, jit);
+  printf("%-10s %10llu instructions %10llu pushes %10llu pops %10.2f ms\n",
+         name, static_cast<unsigned long long>(counts.instructions),
+         static_cast<unsigned long long>(counts.pushes),
+         static_cast<unsigned long long>(counts.pops), ms);
+}
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  const int statements = argc > 1 ? atoi(argv[1]) : 500;
+  const int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+  const std::string source = generate(8, statements);
+
+  CompileOptions stack_options;
+  stack_options.register_ops = false;
+  ByteCode stack_code;
+  if (!compile(source.c_str(), stack_code, stack_options))
+    return 1;
+
+  ByteCode register_code;
+  if (!compile(source.c_str(), register_code))
+    return 1;
+
+  CompileOptions peephole_options;
+  peephole_options.peephole = true;
+  ByteCode peephole_code;
+  if (!compile(source.c_str(), peephole_code, peephole_options))
+    return 1;
+
+  printf("%d statements, %d iterations\n", statements * 2, iterations);
+  report("stack", stack_code, iterations);
+  report("register", register_code, iterations);
+  report("peephole", peephole_code, iterations);
+  report("jit", peephole_code, iterations, true);
+  return 0;
+}
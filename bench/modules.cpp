@@ -0,0 +1,92 @@
+// Builds a generated tree of modules with compile_modules at increasing thread
+// counts, then with a unit cache: cold, warm, and after touching one module.
+
+#include <guise/compiler/module.h>
+#include <guise/vm/byte_code.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace GuiSE;
+
+namespace fs = std::filesystem;
+
+namespace {
+std::string module_name(int i) { return "m" + std::to_string(i) + ".gs"; }
+
+// main.gs imports every other module, and module i also imports module i / 2.
+void generate(const fs::path &directory, int modules, int functions) {
+  for (int i = 0; i < modules; i++) {
+    const std::string n = std::to_string(i);
+    std::ofstream file(directory / (i == 0 ? "main.gs" : module_name(i)));
+    if (i == 0) {
+      for (int j = 1; j < modules; j++) {
+        file << "import \"" << module_name(j) << "\";\n";
+      }
+    } else if (i > 1) {
+      file << "import \"" << module_name(i / 2) << "\";\n";
+    }
+    for (int j = 0; j < functions; j++) {
+      file << "m" << n << "f" << j << " : a num : b num : fn num {\n";
+      file << "  x : num a * b + 1.5;\n";
+      file << "  return x * a - b / 2.5;\n";
+      file << "}\n";
+    }
+  }
+}
+
+double build(const fs::path &root, const ModuleOptions &options,
+             ModuleStats &stats) {
+  const auto start = std::chrono::steady_clock::now();
+  ByteCode byte_code;
+  if (!compile_modules(root.string(), byte_code, options, &stats)) {
+    fprintf(stderr, "build failed\n");
+    exit(1);
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void report(const char *name, double ms, const ModuleStats &stats) {
+  printf("%-12s %10.2f ms %6zu compiled %6zu cached\n", name, ms,
+         stats.compiled, stats.cached);
+}
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  const int modules = argc > 1 ? atoi(argv[1]) : 256;
+  const int functions = argc > 2 ? atoi(argv[2]) : 100;
+  const fs::path directory = fs::temp_directory_path() / "GuiSE_bench_modules";
+  fs::remove_all(directory);
+  fs::create_directories(directory);
+  generate(directory, modules, functions);
+  const fs::path root = directory / "main.gs";
+
+  printf("%d modules, %d functions each\n", modules, functions);
+  ModuleStats stats;
+  const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned threads = 1; threads <= hardware; threads *= 2) {
+    ModuleOptions options;
+    options.threads = threads;
+    const double ms = build(root, options, stats);
+    const std::string name = std::to_string(threads) + " threads";
+    report(name.c_str(), ms, stats);
+  }
+
+  ModuleOptions options;
+  options.cache_dir = (directory / "cache").string();
+  report("cold cache", build(root, options, stats), stats);
+  report("warm cache", build(root, options, stats), stats);
+  std::ofstream(directory / module_name(modules - 1), std::ios::app)
+      << "touched : num 1.0;\n";
+  report("touched one", build(root, options, stats), stats);
+
+  fs::remove_all(directory);
+  return 0;
+}
@@ -0,0 +1,64 @@
+// Measures call throughput of a VMPool running one shared Program, at
+// increasing worker counts.
+
+#include <guise/compiler/compiler.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/program.h>
+#include <guise/vm/vm_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace GuiSE;
+
+namespace {
+// A session-style entry point doing a fixed amount of arithmetic per call.
+std::string generate(int statements) {
+  std::string source = "step : a num : b num : fn num {\n";
+  source += "  return a * b + a / b - b * 0.5;\n}\n";
+  source += "session : x num : y num : fn num {\n";
+  for (int i = 0; i < statements; i++) {
+    source += "  x = step x y + 1.25;\n";
+    source += "  y = step y x / 3.5;\n";
+  }
+  source += "  return x + y;\n}\n";
+  return source;
+}
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  const int calls = argc > 1 ? atoi(argv[1]) : 100000;
+  const int statements = argc > 2 ? atoi(argv[2]) : 50;
+
+  ByteCode byte_code;
+  if (!compile(generate(statements).c_str(), byte_code))
+    return 1;
+  auto program = std::make_shared<const Program>(std::move(byte_code));
+  const int session = program->get_byte_code().FindFunction("session");
+
+  printf("%d calls, %d statements each\n", calls, statements * 2);
+  const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned threads = 1; threads <= hardware; threads *= 2) {
+    VMPool pool(program, threads);
+    std::vector<std::future<CallResult>> results;
+    results.reserve(calls);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+      results.push_back(pool.Submit(session, {i * 0.001, 1.5}));
+    }
+    for (auto &result : results) {
+      result.wait();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double ms =
+        std::chrono::duration<double, std::milli>(end - start).count();
+    printf("%2u threads %10.2f ms %12.0f calls/s\n", threads, ms,
+           calls / ms * 1000.0);
+  }
+  return 0;
+}
@@ -0,0 +1,84 @@
+// Scans a generated multi-megabyte source, then compiles it, reporting
+// tokens and megabytes per second.
+
+#include <guise/compiler/compiler.h>
+#include <guise/compiler/scanner.h>
+#include <guise/vm/byte_code.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace GuiSE;
+
+namespace {
+// Functions with the mix of long names, literals, labels and comments a GUI
+// script has. Their literals are small whole numbers and one str, so however
+// many there are they fit the constant pool.
+std::string generate(size_t bytes) {
+  std::string source = "# generated for GuiSE_bench_scanner\n"
+                       "title : str \"Benchmark window title\";\n";
+  for (int i = 0; source.size() < bytes; i++) {
+    const std::string n = std::to_string(i);
+    source += "# layout of widget " + n + ", recomputed when it resizes\n";
+    source += "widgetWidth" + n +
+              " : parentWidth num : columnCount num : fn num {\n";
+    source += "    spacing : num 12.0;   # between columns\n";
+    source += "    inner : num parentWidth - spacing * 2.0;\n";
+    source += "    fits : bool inner > 0.0 and columnCount >= 1.0;\n";
+    source += "    log \"widget is being laid out again\";\n";
+    source += "    return inner / columnCount + " + std::to_string(i % 100) +
+              ".0;\n";
+    source += "}\n\n";
+  }
+  return source;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  const size_t megabytes = argc > 1 ? atoi(argv[1]) : 8;
+  const int runs = argc > 2 ? atoi(argv[2]) : 5;
+  const std::string source = generate(megabytes << 20);
+  const double mb = source.size() / double(1 << 20);
+
+  double scan = 1e30;
+  size_t tokens = 0;
+  for (int run = 0; run < runs; run++) {
+    const auto start = std::chrono::steady_clock::now();
+    Scanner scanner(source.data(), source.size());
+    Token token;
+    tokens = 0;
+    for (TokenType type; (type = scanner.ScanToken(token)) != TokenType::Eof;
+         tokens++) {
+      if (type == TokenType::Error) {
+        fprintf(stderr, "scan error at line %d\n", token.line);
+        return 1;
+      }
+    }
+    scan = std::min(scan, seconds_since(start));
+  }
+
+  double compiled = 1e30;
+  for (int run = 0; run < runs; run++) {
+    const auto start = std::chrono::steady_clock::now();
+    ByteCode byte_code;
+    if (!compile(source.data(), source.size(), byte_code))
+      return 1;
+    compiled = std::min(compiled, seconds_since(start));
+  }
+
+  printf("%.1f MiB, %zu tokens, best of %d\n", mb, tokens, runs);
+  printf("scan    %8.2f ms %8.1f Mtokens/s %8.1f MiB/s\n", scan * 1e3,
+         tokens / scan / 1e6, mb / scan);
+  printf("compile %8.2f ms %8.1f Mtokens/s %8.1f MiB/s\n", compiled * 1e3,
+         tokens / compiled / 1e6, mb / compiled);
+  return 0;
+}
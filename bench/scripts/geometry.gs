@@ -0,0 +1,42 @@
+# Layout-style numeric helpers, run both interpreted and translated to C++ by
+# GuiSE_bench_aot.
+scale : num 1.25;
+result : num 0.0;
+
+lerp : a num : b num : t num : fn num {
+  return a + (b - a) * t;
+}
+
+area : w num : h num : fn num {
+  return w * h * scale;
+}
+
+aspect : w num : h num : fn num {
+  return w / h;
+}
+
+fits : w num : h num : max num : fn bool {
+  return w <= max and h <= max;
+}
+
+layout : x num : y num : fn num {
+  w : num lerp x y 0.25;
+  h : num lerp y x 0.75;
+  a : num area w h;
+  r : num aspect w h;
+  return a * r - (w + h) / 2.0;
+}
+
+main : fn {
+  x : num 10.0;
+  y : num 20.0;
+  x = layout x y;
+  y = layout y x;
+  x = layout x y / 100.0;
+  y = layout y x / 100.0;
+  x = layout x y / 100.0;
+  y = layout y x / 100.0;
+  x = layout x y / 100.0;
+  y = layout y x / 100.0;
+  result = x + y;
+}
@@ -30,4 +30,26 @@ function(MAKE_SOURCES sources)
     endforeach()
 
     set(${sources} ${${sources}} PARENT_SCOPE)
-endfunction()
\ No newline at end of file
+endfunction()
+
+# Translates script to C++ with the GuiSE executable at build time and compiles
+# the result into target. The generated <name>.h declares the script's
+# functions, a Globals struct and init() in namespace name.
+function(GUISE_ADD_AOT target name script)
+    get_filename_component(script ${script} ABSOLUTE)
+    set(out_dir ${CMAKE_CURRENT_BINARY_DIR}/guise_aot)
+    set(prefix ${out_dir}/${name})
+
+    add_custom_command(
+        OUTPUT ${prefix}.h ${prefix}.cpp
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${out_dir}
+        COMMAND GuiSE --emit-cpp ${prefix} ${script}
+        DEPENDS GuiSE ${script}
+        COMMENT "Translating ${script} to C++"
+        VERBATIM
+    )
+
+    target_sources(${target} PRIVATE ${prefix}.h ${prefix}.cpp)
+    target_include_directories(${target} PRIVATE ${out_dir})
+    target_link_libraries(${target} Compiler VM)
+endfunction()
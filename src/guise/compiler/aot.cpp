@@ -0,0 +1,533 @@
+#include "aot.h"
+
+#include "types.h"
+
+#include <guise/vm/byte_code.h>
+#include <guise/vm/object.h>
+#include <guise/vm/opcode.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace GuiSE;
+
+namespace {
+const char *cpp_type(ValueType type) {
+  switch (type) {
+  case ValueType::Bool:
+    return "GuiSE::Bool";
+  case ValueType::Num:
+    return "GuiSE::Num";
+  case ValueType::Int:
+    return "GuiSE::Int";
+  case ValueType::Str:
+    return "GuiSE::Str *";
+  default:
+    return "void";
+  }
+}
+
+// Value member holding a value of type.
+const char *member(ValueType type) {
+  switch (type) {
+  case ValueType::Bool:
+    return "bool_";
+  case ValueType::Int:
+    return "int_";
+  case ValueType::Str:
+    return "str";
+  default:
+    return "num";
+  }
+}
+
+const char *value_type(ValueType type) {
+  switch (type) {
+  case ValueType::Bool:
+    return "GuiSE::ValueType::Bool";
+  case ValueType::Num:
+    return "GuiSE::ValueType::Num";
+  case ValueType::Int:
+    return "GuiSE::ValueType::Int";
+  case ValueType::Str:
+    return "GuiSE::ValueType::Str";
+  default:
+    return "GuiSE::ValueType::Invalid";
+  }
+}
+
+// Exact spelling of a num, as a hex float where it is finite.
+std::string num_literal(Num num) {
+  if (std::isnan(num))
+    return "std::numeric_limits<GuiSE::Num>::quiet_NaN()";
+  if (std::isinf(num))
+    return num > 0 ? "std::numeric_limits<GuiSE::Num>::infinity()"
+                   : "-std::numeric_limits<GuiSE::Num>::infinity()";
+
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%a", num);
+  return buf;
+}
+
+// By length, as a str from the source may hold NULs, which are escaped along
+// with the other control bytes.
+std::string string_literal(const char *chars, size_t length) {
+  std::string literal = "\"";
+  for (const char *c = chars; c != chars + length; c++) {
+    const unsigned char byte = *c;
+    if (byte == '"' || byte == '\\') {
+      literal += '\\';
+      literal += *c;
+    } else if (byte < 0x20 || byte >= 0x7f) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\%03o", byte);
+      literal += buf;
+    } else {
+      literal += *c;
+    }
+  }
+  return literal + "\"";
+}
+
+// Deepest stack slot reached by straight-line code entered at depth.
+int max_depth(const ByteCode &byte_code, size_t offset, size_t end,
+              int depth) {
+  int max = depth;
+  while (offset < end) {
+    const uint8_t *ip = byte_code[offset];
+    OpCode op_code = static_cast<OpCode>(*ip);
+    if (op_code == OpCode::Wide)
+      op_code = static_cast<OpCode>(ip[1]);
+
+    // calls pop their arguments, leaving the result in the StackUp slot
+    const OpInfo &info = op_info(op_code);
+    depth -= info.pops < 0 ? ip[3] : info.pops;
+    depth += info.pushes;
+    max = std::max(max, depth);
+    offset += instruction_length(ip);
+  }
+  return max;
+}
+
+// Script identifiers that can't be used as C++ names as they are. Generated
+// code also uses s for the stack and p<n> for parameters.
+const std::set<std::string> reserved_names = {
+    "Globals",  "alignas",   "alignof", "asm",      "auto",      "break",
+    "case",     "catch",     "char",    "class",    "const",     "continue",
+    "default",  "delete",    "do",      "double",   "else",      "enum",
+    "explicit", "export",    "extern",  "float",    "for",       "friend",
+    "globals",  "goto",      "init",    "inline",   "int",       "long",
+    "mutable",  "namespace", "new",     "noexcept", "nullptr",   "operator",
+    "private",  "protected", "public",  "register", "return",    "short",
+    "signed",   "sizeof",    "static",  "struct",   "switch",    "template",
+    "this",     "throw",     "try",     "typedef",  "typename",  "union",
+    "unsigned", "using",     "virtual", "void",     "volatile",  "while",
+};
+
+// Emits the body of one function or global initializer. The operand stack is
+// tracked statically, so every slot becomes an element of a local Value array
+// that the C++ compiler can keep in registers.
+class Translator {
+public:
+  Translator(const ByteCode &byte_code, std::ostream &out);
+
+  void Declarations();
+  void Constants();
+  bool Function(int index);
+  bool Init();
+
+private:
+  std::string _signature(int index) const;
+  bool _body(size_t offset, size_t end, int base, int depth,
+             ValueType return_type, const char *indent);
+  std::string _slot(int slot) const;
+  std::string _call(int index, int base) const;
+  std::string _num_operand(const uint8_t *ip) const;
+
+  const ByteCode &_byte_code;
+  std::ostream &_out;
+  std::vector<std::string> _function_names;
+  std::vector<std::string> _global_names;
+  int _base = 0;
+};
+
+Translator::Translator(const ByteCode &byte_code, std::ostream &out)
+    : _byte_code(byte_code), _out(out) {
+  std::set<std::string> used;
+  auto unique_name = [&used](std::string name) {
+    const bool is_param = name.size() > 1 && name[0] == 'p' &&
+                          name.find_first_not_of("0123456789", 1) ==
+                              std::string::npos;
+    if (reserved_names.count(name) > 0 || name == "s" || is_param)
+      name += "_";
+    while (!used.insert(name).second)
+      name += "_";
+    return name;
+  };
+
+  for (size_t i = 0; i < byte_code.FunctionCount(); i++) {
+    _function_names.push_back(unique_name(byte_code.GetFunctionInfo(i).name));
+  }
+  // a redeclared global keeps its own slot, so it gets its own field
+  used.clear();
+  for (size_t i = 0; i < byte_code.GlobalCount(); i++) {
+    // an imported module's globals are qualified by its path
+    const std::string &name = byte_code.GetGlobalInfo(i).name;
+    _global_names.push_back(unique_name(name.substr(name.rfind(':') + 1)));
+  }
+}
+
+void Translator::Declarations() {
+  _out << "struct Globals {\n";
+  for (size_t i = 0; i < _global_names.size(); i++) {
+    _out << "  " << cpp_type(_byte_code.GetGlobalInfo(i).type) << " "
+         << _global_names[i] << "{};\n";
+  }
+  _out << "};\n\n";
+  _out << "extern Globals globals;\n\n";
+  _out << "void init();\n";
+  for (size_t i = 0; i < _function_names.size(); i++) {
+    _out << _signature(i) << ";\n";
+  }
+}
+
+// Constants holding the same interned str share one object, so strs still
+// compare by pointer.
+void Translator::Constants() {
+  std::map<const Str *, size_t> placed;
+  for (size_t i = 0; i < _byte_code.ConstantCount(); i++) {
+    if (_byte_code.GetConstantType(i) != ValueType::Str)
+      continue;
+
+    const Str *str = _byte_code.GetConstant(i).str;
+    const auto it = placed.find(str);
+    if (it != placed.end()) {
+      _out << "GuiSE::Str &str_" << i << " = str_" << it->second << ";\n";
+      continue;
+    }
+    placed[str] = i;
+    _out << "alignas(GuiSE::Str) char str_" << i << "_bytes[GuiSE::Str::Size("
+         << str->get_length() << ")];\n";
+    _out << "GuiSE::Str &str_" << i << " = *GuiSE::Str::Place(str_" << i
+         << "_bytes, " << string_literal(str->get_chars(), str->get_length())
+         << ", " << str->get_length() << ", " << str->get_hash() << "u);\n";
+  }
+}
+
+bool Translator::Function(int index) {
+  const GuiSE::Function &function = _byte_code.GetFunctionInfo(index);
+  _out << _signature(index) << " {\n";
+  _out << "  GuiSE::Value s[" << std::max(function.max_stack, 1) << "];\n";
+  for (size_t i = 0; i < function.params.size(); i++) {
+    _out << "  s[" << i << "] = p" << i << ";\n";
+  }
+
+  const bool success = _body(function.offset, function.end, 0,
+                             function.arity, function.return_type, "  ");
+  _out << "}\n";
+  return success;
+}
+
+bool Translator::Init() {
+  _out << "void init() {\n";
+  bool success = true;
+  for (size_t i = 0; i < _global_names.size() && success; i++) {
+    // each initializer leaves its value in the global's own slot
+    const Global &global = _byte_code.GetGlobalInfo(i);
+    _out << "  {\n";
+    const int slots = max_depth(_byte_code, global.offset, global.end, i) - i;
+    _out << "    GuiSE::Value s[" << std::max(slots, 1) << "];\n";
+    success = _body(global.offset, global.end, i, i, ValueType::Void, "    ");
+    _out << "    globals." << _global_names[i] << " = s[0]."
+         << member(global.type) << ";\n";
+    _out << "  }\n";
+  }
+  _out << "}\n";
+  return success;
+}
+
+std::string Translator::_signature(int index) const {
+  const GuiSE::Function &function = _byte_code.GetFunctionInfo(index);
+  std::string signature = cpp_type(function.return_type);
+  signature += " " + _function_names[index] + "(";
+  for (size_t i = 0; i < function.params.size(); i++) {
+    if (i > 0)
+      signature += ", ";
+    signature += cpp_type(function.params[i]);
+    signature += " p" + std::to_string(i);
+  }
+  return signature + ")";
+}
+
+std::string Translator::_slot(int slot) const {
+  return "s[" + std::to_string(slot - _base) + "]";
+}
+
+std::string Translator::_call(int index, int base) const {
+  const GuiSE::Function &function = _byte_code.GetFunctionInfo(index);
+  std::string call = _function_names[index] + "(";
+  for (size_t i = 0; i < function.params.size(); i++) {
+    if (i > 0)
+      call += ", ";
+    call += _slot(base + i) + "." + member(function.params[i]);
+  }
+  return call + ")";
+}
+
+// The constant or immediate operand of a register instruction.
+std::string Translator::_num_operand(const uint8_t *ip) const {
+  switch (static_cast<OpCode>(ip[0])) {
+  case OpCode::AddLocalConst:
+  case OpCode::SubtractLocalConst:
+  case OpCode::MultiplyLocalConst:
+  case OpCode::DivideLocalConst:
+    return num_literal(_byte_code.GetConstant(ip[2]).num);
+  case OpCode::AddLocalImm:
+  case OpCode::SubtractLocalImm:
+  case OpCode::MultiplyLocalImm:
+  case OpCode::DivideLocalImm:
+    return num_literal(static_cast<int8_t>(ip[2]));
+  default:
+    return _slot(ip[2]) + ".num";
+  }
+}
+
+bool Translator::_body(size_t offset, size_t end, int base, int depth,
+                       ValueType return_type, const char *indent) {
+  _base = base;
+  ValueType log_type = ValueType::Invalid;
+
+  for (; offset < end;) {
+    const uint8_t *ip = _byte_code[offset];
+    offset += instruction_length(ip);
+
+    OpCode op_code = static_cast<OpCode>(ip[0]);
+    int operand = op_info(op_code).operand_bytes > 0 ? ip[1] : 0;
+    if (op_code == OpCode::Wide) {
+      op_code = static_cast<OpCode>(ip[1]);
+      operand = ip[2] | ip[3] << 8;
+    }
+
+    // these only move the stack depth or set the type of the next log
+    if (op_code == OpCode::StackUp) {
+      depth++;
+      continue;
+    } else if (op_code == OpCode::Pop) {
+      depth--;
+      continue;
+    } else if (op_code == OpCode::TypeArg) {
+      log_type = static_cast<ValueType>(operand);
+      continue;
+    }
+
+    const std::string top = _slot(depth - 1);
+    const std::string second = _slot(depth - 2);
+    _out << indent;
+    switch (op_code) {
+    case OpCode::Constant:
+      if (_byte_code.GetConstantType(operand) == ValueType::Str) {
+        _out << _slot(depth) << ".str = &str_" << operand << ";\n";
+      } else {
+        _out << _slot(depth)
+             << ".num = " << num_literal(_byte_code.GetConstant(operand).num)
+             << ";\n";
+      }
+      depth++;
+      break;
+    case OpCode::GetGlobal:
+      _out << _slot(depth) << " = GuiSE::Value(globals."
+           << _global_names[operand] << ");\n";
+      depth++;
+      break;
+    case OpCode::SetGlobal:
+      _out << "globals." << _global_names[operand] << " = " << top << "."
+           << member(_byte_code.GetGlobalInfo(operand).type) << ";\n";
+      break;
+    case OpCode::GetLocal:
+      _out << _slot(depth) << " = " << _slot(operand) << ";\n";
+      depth++;
+      break;
+    case OpCode::SetLocal:
+      _out << _slot(operand) << " = " << top << ";\n";
+      break;
+    case OpCode::PushZero:
+    case OpCode::PushSmallNum:
+      _out << _slot(depth) << ".num = "
+           << num_literal(static_cast<int8_t>(operand)) << ";\n";
+      depth++;
+      break;
+    case OpCode::True:
+    case OpCode::False:
+      _out << _slot(depth) << ".bool_ = "
+           << (op_code == OpCode::True ? "true" : "false") << ";\n";
+      depth++;
+      break;
+    case OpCode::Add:
+    case OpCode::Subtract:
+    case OpCode::Multiply:
+    case OpCode::Divide: {
+      const char *op = op_code == OpCode::Add        ? " + "
+                       : op_code == OpCode::Subtract ? " - "
+                       : op_code == OpCode::Multiply ? " * "
+                                                     : " / ";
+      _out << second << ".num = " << second << ".num" << op << top
+           << ".num;\n";
+      depth--;
+    } break;
+    case OpCode::AddLocalLocal:
+    case OpCode::AddLocalConst:
+    case OpCode::AddLocalImm:
+      _out << _slot(depth) << ".num = " << _slot(ip[1]) << ".num + "
+           << _num_operand(ip) << ";\n";
+      depth++;
+      break;
+    case OpCode::SubtractLocalLocal:
+    case OpCode::SubtractLocalConst:
+    case OpCode::SubtractLocalImm:
+      _out << _slot(depth) << ".num = " << _slot(ip[1]) << ".num - "
+           << _num_operand(ip) << ";\n";
+      depth++;
+      break;
+    case OpCode::MultiplyLocalLocal:
+    case OpCode::MultiplyLocalConst:
+    case OpCode::MultiplyLocalImm:
+      _out << _slot(depth) << ".num = " << _slot(ip[1]) << ".num * "
+           << _num_operand(ip) << ";\n";
+      depth++;
+      break;
+    case OpCode::DivideLocalLocal:
+    case OpCode::DivideLocalConst:
+    case OpCode::DivideLocalImm:
+      _out << _slot(depth) << ".num = " << _slot(ip[1]) << ".num / "
+           << _num_operand(ip) << ";\n";
+      depth++;
+      break;
+    case OpCode::Negate:
+      _out << top << ".num = -" << top << ".num;\n";
+      break;
+    case OpCode::Not:
+      _out << top << ".bool_ = !" << top << ".bool_;\n";
+      break;
+    // the same expressions as the VM's operators, so NaN compares alike
+    case OpCode::Equal:
+      _out << second << ".bool_ = " << second << ".num == " << top
+           << ".num;\n";
+      depth--;
+      break;
+    case OpCode::NotEqual:
+      _out << second << ".bool_ = !(" << second << ".num == " << top
+           << ".num);\n";
+      depth--;
+      break;
+    case OpCode::Greater:
+      _out << second << ".bool_ = " << second << ".num > " << top
+           << ".num;\n";
+      depth--;
+      break;
+    case OpCode::GreaterEqual:
+      _out << second << ".bool_ = !(" << second << ".num < " << top
+           << ".num);\n";
+      depth--;
+      break;
+    case OpCode::Less:
+      _out << second << ".bool_ = " << second << ".num < " << top
+           << ".num;\n";
+      depth--;
+      break;
+    case OpCode::LessEqual:
+      _out << second << ".bool_ = !(" << second << ".num > " << top
+           << ".num);\n";
+      depth--;
+      break;
+    case OpCode::EqualStr:
+      _out << second << ".bool_ = " << second << ".str == " << top
+           << ".str;\n";
+      depth--;
+      break;
+    case OpCode::And:
+      _out << second << ".bool_ = " << second << ".bool_ && " << top
+           << ".bool_;\n";
+      depth--;
+      break;
+    case OpCode::Or:
+      _out << second << ".bool_ = " << second << ".bool_ || " << top
+           << ".bool_;\n";
+      depth--;
+      break;
+    case OpCode::Log:
+      _out << "GuiSE::log_value(" << value_type(log_type) << ", " << top
+           << ");\n";
+      depth--;
+      break;
+    // memoized calls lose their cache but compute the same results
+    case OpCode::CallDirect:
+    case OpCode::CallMemo:
+    case OpCode::TailCall: {
+      const int index = ip[1] | ip[2] << 8;
+      const int call_base = depth - ip[3];
+      const bool is_void = _byte_code.GetFunctionInfo(index).return_type ==
+                           ValueType::Void;
+      if (op_code == OpCode::TailCall) {
+        _out << (is_void ? "" : "return ") << _call(index, call_base)
+             << (is_void ? "; return;\n" : ";\n");
+      } else if (is_void) {
+        _out << _call(index, call_base) << ";\n";
+      } else {
+        _out << _slot(call_base - 1) << " = GuiSE::Value("
+             << _call(index, call_base) << ");\n";
+      }
+      depth = call_base;
+    } break;
+    case OpCode::Return:
+    case OpCode::ReturnMemo:
+      if (return_type == ValueType::Void) {
+        _out << "return;\n";
+      } else {
+        _out << "return " << top << "." << member(return_type) << ";\n";
+      }
+      depth--;
+      break;
+    default:
+      _out << "// unsupported " << op_info(op_code).name << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+bool GuiSE::emit_cpp(const ByteCode &byte_code, const std::string &name_space,
+                     const std::string &header_name, std::ostream &header,
+                     std::ostream &source) {
+  header << "// Generated by GuiSE, do not edit.\n";
+  header << "#pragma once\n\n";
+  header << "#include <guise/compiler/types.h>\n\n";
+  header << "namespace " << name_space << " {\n";
+  Translator(byte_code, header).Declarations();
+  header << "} // namespace " << name_space << "\n";
+
+  source << "// Generated by GuiSE, do not edit.\n";
+  source << "#include \"" << header_name << "\"\n\n";
+  source << "#include <guise/vm/object.h>\n\n";
+  source << "#include <limits>\n\n";
+  source << "namespace " << name_space << " {\n";
+  source << "Globals globals;\n\n";
+  source << "namespace {\n";
+
+  Translator translator(byte_code, source);
+  translator.Constants();
+  source << "} // namespace\n\n";
+
+  bool success = true;
+  for (size_t i = 0; i < byte_code.FunctionCount() && success; i++) {
+    success = translator.Function(i);
+    source << "\n";
+  }
+  success = success && translator.Init();
+  source << "} // namespace " << name_space << "\n";
+  return success;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+namespace GuiSE {
+class ByteCode;
+
+// Translates compiled byte code into a C++ header and source. In namespace
+// name_space they declare one function per script function, a Globals struct
+// holding every global and an init function that runs the global
+// initializers, as VM::RunGlobal does. The source includes the header as
+// header_name. Returns false on an instruction with no translation.
+bool emit_cpp(const ByteCode &byte_code, const std::string &name_space,
+              const std::string &header_name, std::ostream &header,
+              std::ostream &source);
+} // namespace GuiSE
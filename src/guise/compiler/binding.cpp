@@ -2,87 +2,81 @@
 
 using namespace GuiSE;
 
-Scope::Scope() : _stack_frame_offset(0) {}
-
-Scope::Scope(const Scope &scope)
-    : _stack_frame_offset(scope._stack_frame_offset) {}
-
-void Scope::AddVar(const BindingId &id, ValueType type) {
-  _var_bindings[id] = VarBinding(type, _stack_frame_offset++);
-}
-
-const VarBinding *Scope::FindVar(const BindingId &id) const {
-  auto it = _var_bindings.find(id);
-  if (it != _var_bindings.end()) {
-    return &it->second;
-  }
-  return nullptr;
-}
-
-Scope::VarBindingMap::const_iterator Scope::begin() const {
-  return _var_bindings.begin();
-}
-
-Scope::VarBindingMap::const_iterator Scope::end() const {
-  return _var_bindings.end();
+namespace {
+// Grows a per-symbol array to hold id.
+template <typename T>
+void reserve_symbol(std::vector<T> &bindings, SymbolId id, const T &unbound) {
+  if (id >= bindings.size())
+    bindings.resize(id + 1, unbound);
 }
+} // namespace
 
 VarBinding::VarBinding(ValueType type, int offset)
     : _type(type), _offset(offset) {}
 
-FnBinding::FnBinding(int constant, const std::vector<Param> &params,
-                     ValueType return_type)
-    : _constant(constant), _params(params), _return_type(return_type) {}
+FnBinding::FnBinding(int index, const std::vector<Param> &params,
+                     ValueType return_type, bool memoized)
+    : _index(index), _params(params), _return_type(return_type),
+      _memoized(memoized) {}
 
-bool ScopeStack::AddFn(const BindingId &id, int constant,
+bool ScopeStack::AddFn(SymbolId id, int index,
                        const std::vector<Param> &params,
-                       ValueType return_type) {
+                       ValueType return_type, bool memoized) {
   if (!_stack.empty())
     return false;
 
-  auto it = _fn_bindings.find(id);
-  if (it != _fn_bindings.end())
+  reserve_symbol(_fn_indices, id, -1);
+  if (_fn_indices[id] != -1)
     return false;
 
-  _fn_bindings.insert({id, FnBinding(constant, params, return_type)});
+  _fn_indices[id] = _fn_bindings.size();
+  _fn_bindings.emplace_back(index, params, return_type, memoized);
   return true;
 }
 
-void ScopeStack::AddVar(const BindingId &id, ValueType type) {
+void ScopeStack::AddVar(SymbolId id, ValueType type) {
   if (_stack.empty()) {
+    reserve_symbol(_var_bindings, id, VarBinding());
     _var_bindings[id] = VarBinding(type, _global_offset++);
   } else {
-    _stack.back().AddVar(id, type);
+    reserve_symbol(_local_bindings, id, VarBinding());
+    _shadowed.push_back({id, _local_bindings[id]});
+    _local_bindings[id] = VarBinding(type, _stack.back().stack_frame_offset++);
   }
 }
 
-const FnBinding *ScopeStack::FindFn(const BindingId &id) {
-  auto it = _fn_bindings.find(id);
-  if (it != _fn_bindings.end()) {
-    return &it->second;
+const FnBinding *ScopeStack::FindFn(SymbolId id) const {
+  if (id < _fn_indices.size() && _fn_indices[id] != -1) {
+    return &_fn_bindings[_fn_indices[id]];
   }
   return nullptr;
 }
 
-const VarBinding *ScopeStack::FindVar(const BindingId &id,
-                                      bool &is_global) const {
-  for (auto it = _stack.crbegin(); it != _stack.crend(); it++) {
-    const VarBinding *var_binding = it->FindVar(id);
-    if (var_binding != nullptr) {
-      is_global = false;
-      return var_binding;
-    }
+const VarBinding *ScopeStack::FindVar(SymbolId id, bool &is_global) const {
+  if (id < _local_bindings.size() && _local_bindings[id].is_bound()) {
+    is_global = false;
+    return &_local_bindings[id];
   }
-  auto it = _var_bindings.find(id);
-  if (it != _var_bindings.end()) {
+  if (id < _var_bindings.size() && _var_bindings[id].is_bound()) {
     is_global = true;
-    return &it->second;
+    return &_var_bindings[id];
   }
   return nullptr;
 }
 
-void ScopeStack::PushFnScope() { _stack.emplace_back(); }
+void ScopeStack::PushFnScope() { _stack.push_back({_shadowed.size(), 0}); }
 
-void ScopeStack::PushBlockScope() { _stack.emplace_back(_stack.back()); }
+void ScopeStack::PushBlockScope() {
+  _stack.push_back({_shadowed.size(), _stack.back().stack_frame_offset});
+}
 
-void ScopeStack::Pop() { _stack.pop_back(); }
+// Restores what the scope's locals hid, latest first.
+void ScopeStack::Pop() {
+  const size_t shadowed = _stack.back().shadowed;
+  while (_shadowed.size() > shadowed) {
+    const Shadowed &entry = _shadowed.back();
+    _local_bindings[entry.id] = entry.binding;
+    _shadowed.pop_back();
+  }
+  _stack.pop_back();
+}
@@ -1,14 +1,12 @@
 #pragma once
 
+#include "symbol.h"
 #include "types.h"
 
-#include <map>
-#include <set>
-#include <string>
+#include <deque>
 #include <vector>
 
 namespace GuiSE {
-using BindingId = std::string;
 
 class VarBinding {
 public:
@@ -18,6 +16,7 @@ public:
 
   inline ValueType get_type() const { return _type; }
   inline int get_offset() const { return _offset; }
+  inline bool is_bound() const { return _type != ValueType::Invalid; }
 
 private:
   ValueType _type = ValueType::Invalid;
@@ -25,63 +24,66 @@ private:
 };
 
 struct Param {
-  const BindingId id;
+  const SymbolId id;
   ValueType type;
 };
 
 class FnBinding {
 public:
-  FnBinding(int constant, const std::vector<Param> &params,
-            ValueType return_type);
+  FnBinding(int index, const std::vector<Param> &params,
+            ValueType return_type, bool memoized);
 
   inline const std::vector<Param> &get_params() const { return _params; }
-  inline int get_constant() const { return _constant; }
+  inline int get_index() const { return _index; }
   inline ValueType get_return_type() const { return _return_type; }
+  inline bool is_memoized() const { return _memoized; }
 
 private:
   std::vector<Param> _params;
-  int _constant;
+  int _index;
   ValueType _return_type;
+  bool _memoized;
 };
 
-class Scope {
-public:
-  Scope();
-  Scope(const Scope &scope);
-
-  void AddVar(const BindingId &id, ValueType type);
-  const VarBinding *FindVar(const BindingId &id) const;
-
-  using VarBindingMap = std::map<BindingId, VarBinding>;
-
-  VarBindingMap::const_iterator begin() const;
-  VarBindingMap::const_iterator end() const;
-
-private:
-  VarBindingMap _var_bindings;
-  int _stack_frame_offset;
-};
-
+// Bindings of every name in scope, kept in arrays indexed by SymbolId so a
+// lookup is one index whatever the depth of the scope stack. A local hiding
+// another binding of its name saves that binding, which Pop restores.
 class ScopeStack {
 public:
-  bool AddFn(const BindingId &id, int byte_offset,
-             const std::vector<Param> &params, ValueType return_type);
-  void AddVar(const BindingId &id, ValueType type);
+  bool AddFn(SymbolId id, int index, const std::vector<Param> &params,
+             ValueType return_type, bool memoized);
+  void AddVar(SymbolId id, ValueType type);
 
-  const FnBinding *FindFn(const BindingId &id);
-  const VarBinding *FindVar(const BindingId &id, bool &is_global) const;
+  const FnBinding *FindFn(SymbolId id) const;
+  const VarBinding *FindVar(SymbolId id, bool &is_global) const;
 
   void PushFnScope();
   void PushBlockScope();
 
   void Pop();
 
+  inline int get_global_count() const { return _global_offset; }
+
 private:
-  std::vector<Scope> _stack;
+  struct Scope {
+    size_t shadowed; // size of _shadowed when the scope was pushed
+    int stack_frame_offset;
+  };
+
+  struct Shadowed {
+    SymbolId id;
+    VarBinding binding;
+  };
 
-  // global bindings
-  std::map<BindingId, FnBinding> _fn_bindings;
-  std::map<BindingId, VarBinding> _var_bindings;
+  std::vector<Scope> _stack;
+  std::vector<Shadowed> _shadowed;
+
+  // indexed by SymbolId, an Invalid type where the name is not bound
+  std::vector<VarBinding> _local_bindings;
+  std::vector<VarBinding> _var_bindings; // globals
+  // indexed by SymbolId, -1 where the name is not bound to a function
+  std::vector<int> _fn_indices;
+  std::deque<FnBinding> _fn_bindings; // never moved, so bindings stay put
   int _global_offset = 0;
 };
-} // namespace GuiSE
\ No newline at end of file
+} // namespace GuiSE
@@ -1,16 +1,25 @@
 #include "compiler.h"
 
 #include "disassembler.h"
+#include "optimizer.h"
 #include "parser.h"
 #include "scanner.h"
+#include "symbol.h"
 
 #include <guise/debug.h>
 #include <guise/vm/byte_code.h>
 
-bool GuiSE::compile(const char *source, ByteCode &byte_code) {
-  Scanner scanner(source);
-  Parser parser(scanner, byte_code);
+#include <cstring>
+
+using namespace GuiSE;
+
+namespace {
+bool parse(Parser &parser, ByteCode &byte_code,
+           const CompileOptions &options) {
   const bool success = parser.Parse();
+  if (success && options.peephole) {
+    optimize(byte_code);
+  }
 #ifdef GUISE_DEBUG
   if (success) {
     disassemble(byte_code);
@@ -18,3 +27,32 @@ bool GuiSE::compile(const char *source, ByteCode &byte_code) {
 #endif
   return success;
 }
+} // namespace
+
+bool GuiSE::compile(const char *source, ByteCode &byte_code,
+                    const CompileOptions &options) {
+  return compile(source, strlen(source), byte_code, options);
+}
+
+bool GuiSE::compile(const char *source, size_t length, ByteCode &byte_code,
+                    const CompileOptions &options) {
+  SymbolTable symbols;
+  Scanner scanner(source, length, &symbols);
+  Parser parser(scanner, symbols, byte_code, options);
+  return parse(parser, byte_code, options);
+}
+
+bool GuiSE::compile_unit(const char *source, const std::vector<Export> &imports,
+                         ByteCode &byte_code, const CompileOptions &options) {
+  return compile_unit(source, strlen(source), imports, byte_code, options);
+}
+
+bool GuiSE::compile_unit(const char *source, size_t length,
+                         const std::vector<Export> &imports,
+                         ByteCode &byte_code, const CompileOptions &options) {
+  SymbolTable symbols;
+  Scanner scanner(source, length, &symbols);
+  Parser parser(scanner, symbols, byte_code, options);
+  parser.Import(imports);
+  return parse(parser, byte_code, options);
+}
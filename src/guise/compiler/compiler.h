@@ -1,7 +1,50 @@
 #pragma once
 
+#include "types.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
 namespace GuiSE {
 class ByteCode;
 
-bool compile(const char *source, ByteCode &byte_code);
-} // namespace GuiSE
\ No newline at end of file
+struct CompileOptions {
+  // fuse binary operations on two locals into register instructions
+  bool register_ops = true;
+  // evaluate operations on literals and drop identity operations while
+  // parsing
+  bool fold_constants = true;
+  // run the peephole superinstruction pass over the finished byte code
+  bool peephole = false;
+};
+
+// A function a module makes callable from the modules that import it.
+struct Export {
+  std::string name;
+  std::vector<ValueType> params;
+  ValueType return_type;
+  bool memoized;
+};
+
+bool compile(const char *source, ByteCode &byte_code,
+             const CompileOptions &options = CompileOptions());
+
+// Compiles the length chars at source, which need not end in a NUL, such as
+// a mapped file. A NUL inside a str or comment is kept as any other char;
+// anywhere else it is an unexpected character rather than the end of the
+// source.
+bool compile(const char *source, size_t length, ByteCode &byte_code,
+             const CompileOptions &options = CompileOptions());
+
+// Compiles one module of a multi-file build on its own. Calls to imports are
+// left as external functions for link to resolve, and the module's import
+// statements are skipped since the module build has already followed them.
+bool compile_unit(const char *source, const std::vector<Export> &imports,
+                  ByteCode &byte_code,
+                  const CompileOptions &options = CompileOptions());
+
+bool compile_unit(const char *source, size_t length,
+                  const std::vector<Export> &imports, ByteCode &byte_code,
+                  const CompileOptions &options = CompileOptions());
+} // namespace GuiSE
@@ -16,10 +16,37 @@ void simple_instruction(const char *name, const uint8_t *&instruction) {
 
 void arg_instruction(const char *name, const uint8_t *&instruction) {
   const uint8_t arg = *(instruction + 1);
-  printf("%-16s %d\n", name, arg);
+  printf("%-20s %d\n", name, arg);
   instruction += 2;
 }
 
+void call_instruction(const char *name, const uint8_t *&instruction) {
+  const uint16_t index = instruction[1] | instruction[2] << 8;
+  const uint8_t arg_count = instruction[3];
+  printf("%-20s %d %d\n", name, index, arg_count);
+  instruction += 4;
+}
+
+void wide_instruction(const uint8_t *&instruction) {
+  const OpCode op_code = static_cast<OpCode>(instruction[1]);
+  const uint16_t arg = instruction[2] | instruction[3] << 8;
+  printf("WIDE %-15s %d\n", op_info(op_code).name, arg);
+  instruction += 4;
+}
+
+void signed_arg_instruction(const char *name, const uint8_t *&instruction) {
+  const int8_t arg = static_cast<int8_t>(*(instruction + 1));
+  printf("%-20s %d\n", name, arg);
+  instruction += 2;
+}
+
+void register_instruction(const char *name, const uint8_t *&instruction) {
+  const uint8_t a = *(instruction + 1);
+  const uint8_t b = *(instruction + 2);
+  printf("%-20s %d %d\n", name, a, b);
+  instruction += 3;
+}
+
 void disassemble_instruction(const uint8_t *&instruction) {
   uint8_t byte = *instruction;
   switch (static_cast<OpCode>(byte)) {
@@ -29,9 +56,6 @@ void disassemble_instruction(const uint8_t *&instruction) {
   case OpCode::Constant:
     arg_instruction("CONSTANT", instruction);
     return;
-  case OpCode::Global:
-    simple_instruction("GLOBAL", instruction);
-    return;
   case OpCode::GetGlobal:
     arg_instruction("GET_GLOBAL", instruction);
     return;
@@ -44,8 +68,8 @@ void disassemble_instruction(const uint8_t *&instruction) {
   case OpCode::SetLocal:
     arg_instruction("SET_LOCAL", instruction);
     return;
-  case OpCode::Call:
-    arg_instruction("CALL", instruction);
+  case OpCode::CallDirect:
+    call_instruction("CALL_DIRECT", instruction);
     return;
   case OpCode::StackUp:
     simple_instruction("STACK_UP", instruction);
@@ -65,6 +89,9 @@ void disassemble_instruction(const uint8_t *&instruction) {
   case OpCode::Equal:
     simple_instruction("EQUAL", instruction);
     return;
+  case OpCode::EqualStr:
+    simple_instruction("EQUAL_STR", instruction);
+    return;
   case OpCode::Greater:
     simple_instruction("GREATER", instruction);
     return;
@@ -98,6 +125,75 @@ void disassemble_instruction(const uint8_t *&instruction) {
   case OpCode::Return:
     simple_instruction("RETURN", instruction);
     return;
+  case OpCode::AddLocalLocal:
+    register_instruction("ADD_LOCAL_LOCAL", instruction);
+    return;
+  case OpCode::SubtractLocalLocal:
+    register_instruction("SUBTRACT_LOCAL_LOCAL", instruction);
+    return;
+  case OpCode::MultiplyLocalLocal:
+    register_instruction("MULTIPLY_LOCAL_LOCAL", instruction);
+    return;
+  case OpCode::DivideLocalLocal:
+    register_instruction("DIVIDE_LOCAL_LOCAL", instruction);
+    return;
+  case OpCode::Subtract:
+    simple_instruction("SUBTRACT", instruction);
+    return;
+  case OpCode::NotEqual:
+    simple_instruction("NOT_EQUAL", instruction);
+    return;
+  case OpCode::GreaterEqual:
+    simple_instruction("GREATER_EQUAL", instruction);
+    return;
+  case OpCode::LessEqual:
+    simple_instruction("LESS_EQUAL", instruction);
+    return;
+  case OpCode::AddLocalConst:
+    register_instruction("ADD_LOCAL_CONST", instruction);
+    return;
+  case OpCode::SubtractLocalConst:
+    register_instruction("SUBTRACT_LOCAL_CONST", instruction);
+    return;
+  case OpCode::MultiplyLocalConst:
+    register_instruction("MULTIPLY_LOCAL_CONST", instruction);
+    return;
+  case OpCode::DivideLocalConst:
+    register_instruction("DIVIDE_LOCAL_CONST", instruction);
+    return;
+  case OpCode::TailCall:
+    call_instruction("TAIL_CALL", instruction);
+    return;
+  case OpCode::CallMemo:
+    call_instruction("CALL_MEMO", instruction);
+    return;
+  case OpCode::ReturnMemo:
+    simple_instruction("RETURN_MEMO", instruction);
+    return;
+  case OpCode::Format:
+    call_instruction("FORMAT", instruction);
+    return;
+  case OpCode::Wide:
+    wide_instruction(instruction);
+    return;
+  case OpCode::PushZero:
+    simple_instruction("PUSH_ZERO", instruction);
+    return;
+  case OpCode::PushSmallNum:
+    signed_arg_instruction("PUSH_SMALL_NUM", instruction);
+    return;
+  case OpCode::AddLocalImm:
+    register_instruction("ADD_LOCAL_IMM", instruction);
+    return;
+  case OpCode::SubtractLocalImm:
+    register_instruction("SUBTRACT_LOCAL_IMM", instruction);
+    return;
+  case OpCode::MultiplyLocalImm:
+    register_instruction("MULTIPLY_LOCAL_IMM", instruction);
+    return;
+  case OpCode::DivideLocalImm:
+    register_instruction("DIVIDE_LOCAL_IMM", instruction);
+    return;
   default:
     printf("Unknown opcode %d\n", byte);
     instruction++;
@@ -0,0 +1,332 @@
+#include "linker.h"
+
+#include <guise/compiler/types.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/object.h>
+#include <guise/vm/opcode.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <map>
+
+using namespace GuiSE;
+
+namespace {
+void emit_short(ByteCode &byte_code, uint16_t value) {
+  byte_code.Write(value & 0xff);
+  byte_code.Write(value >> 8);
+}
+
+// The index operand of an instruction, with or without a Wide prefix.
+size_t index(const uint8_t *ip) {
+  if (static_cast<OpCode>(*ip) == OpCode::Wide)
+    return ip[2] | ip[3] << 8;
+  return ip[1];
+}
+
+// Renumbering can push an index past one byte, so the Wide prefix is added or
+// dropped as needed.
+bool emit_indexed(ByteCode &byte_code, OpCode op_code, size_t index) {
+  if (index <= std::numeric_limits<uint8_t>::max()) {
+    byte_code.Write(static_cast<uint8_t>(op_code));
+    byte_code.Write(index);
+  } else if (index <= std::numeric_limits<uint16_t>::max()) {
+    byte_code.Write(static_cast<uint8_t>(OpCode::Wide));
+    byte_code.Write(static_cast<uint8_t>(op_code));
+    emit_short(byte_code, index);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+OpCode const_binary_op(OpCode op_code) {
+  switch (op_code) {
+  case OpCode::AddLocalConst:
+    return OpCode::Add;
+  case OpCode::SubtractLocalConst:
+    return OpCode::Subtract;
+  case OpCode::MultiplyLocalConst:
+    return OpCode::Multiply;
+  case OpCode::DivideLocalConst:
+    return OpCode::Divide;
+  default:
+    return OpCode::NoOp;
+  }
+}
+
+bool same_signature(const Function &a, const Function &b) {
+  return a.params == b.params && a.return_type == b.return_type &&
+         a.memoized == b.memoized;
+}
+
+class Linker {
+public:
+  Linker(const std::vector<const ByteCode *> &units,
+         const std::vector<std::string> &unit_names, ByteCode &byte_code)
+      : _units(units), _unit_names(unit_names), _byte_code(byte_code) {}
+
+  bool Link();
+
+private:
+  bool _bind_functions();
+  bool _append(size_t unit, size_t begin, size_t end);
+  bool _declare(size_t unit);
+  bool _error(const std::string &message, size_t unit);
+
+  struct Definition {
+    const Function *function;
+    int index; // in the linked code
+  };
+
+  // Where one unit's code and tables land in the linked code.
+  struct Placement {
+    size_t constant_base = 0;
+    size_t format_base = 0;
+    size_t global_base = 0;
+    std::vector<size_t> relocations; // by instruction offset in the unit
+    size_t function_end = 0;         // end of the unit's function code
+    bool expanded = false; // a register instruction needed an extra slot
+  };
+
+  const std::vector<const ByteCode *> &_units;
+  const std::vector<std::string> &_unit_names;
+  ByteCode &_byte_code;
+  // linked function index of every function of every unit
+  std::vector<std::vector<int>> _function_indices;
+  std::map<std::string, Definition> _definitions;
+  std::vector<Placement> _placements;
+};
+
+// Lays out the function code of every unit, then the global initializers of
+// every unit as one block ended by NoOp, so globals still run in slot order.
+bool Linker::Link() {
+  if (!_bind_functions())
+    return false;
+
+  _placements.resize(_units.size());
+  size_t global_base = 0;
+  for (size_t unit = 0; unit < _units.size(); unit++) {
+    const ByteCode &code = *_units[unit];
+    Placement &placement = _placements[unit];
+    placement.constant_base = _byte_code.ConstantCount();
+    placement.global_base = global_base;
+    placement.relocations.resize(code.Length() + 1);
+    global_base += code.GlobalCount();
+    // strs are copied, as the units and their heaps may not outlive the
+    // linked code
+    for (size_t i = 0; i < code.ConstantCount(); i++) {
+      Value value = code.GetConstant(i);
+      const ValueType type = code.GetConstantType(i);
+      if (type == ValueType::Str)
+        value = _byte_code.NewStr(value.str->get_chars(),
+                                  value.str->get_length());
+      _byte_code.AddConstant(value, type);
+    }
+    placement.format_base = _byte_code.FormatCount();
+    for (size_t i = 0; i < code.FormatCount(); i++) {
+      _byte_code.AddFormat(code.GetFormat(i));
+    }
+  }
+
+  for (size_t unit = 0; unit < _units.size(); unit++) {
+    if (!_append(unit, 0, _units[unit]->GetGlobalInit()))
+      return false;
+    _placements[unit].function_end = _byte_code.Length();
+  }
+  const size_t init = _byte_code.Length();
+  for (size_t unit = 0; unit < _units.size(); unit++) {
+    // everything but the unit's closing NoOp
+    if (!_append(unit, _units[unit]->GetGlobalInit(),
+                 _units[unit]->Length() - 1))
+      return false;
+  }
+  _byte_code.Write(static_cast<uint8_t>(OpCode::NoOp));
+  _byte_code.SetGlobalInit(init);
+
+  for (size_t unit = 0; unit < _units.size(); unit++) {
+    if (!_declare(unit))
+      return false;
+  }
+  return true;
+}
+
+// Numbers the defined functions in unit order, which is the order _append
+// adds them in, then points each external function at its definition.
+bool Linker::_bind_functions() {
+  _function_indices.resize(_units.size());
+  int next = 0;
+  for (size_t unit = 0; unit < _units.size(); unit++) {
+    const ByteCode &code = *_units[unit];
+    _function_indices[unit].resize(code.FunctionCount(), -1);
+    for (size_t i = 0; i < code.FunctionCount(); i++) {
+      const Function &function = code.GetFunctionInfo(i);
+      if (function.external)
+        continue;
+      if (!_definitions.insert({function.name, {&function, next}}).second)
+        return _error("Function '" + function.name + "' is already defined.",
+                      unit);
+      _function_indices[unit][i] = next++;
+    }
+  }
+
+  for (size_t unit = 0; unit < _units.size(); unit++) {
+    const ByteCode &code = *_units[unit];
+    for (size_t i = 0; i < code.FunctionCount(); i++) {
+      const Function &function = code.GetFunctionInfo(i);
+      if (!function.external)
+        continue;
+      auto it = _definitions.find(function.name);
+      if (it == _definitions.end())
+        return _error("Unresolved function '" + function.name + "'.", unit);
+      if (!same_signature(function, *it->second.function))
+        return _error("Function '" + function.name +
+                          "' does not match its definition.",
+                      unit);
+      _function_indices[unit][i] = it->second.index;
+    }
+  }
+  return true;
+}
+
+// Copies the unit's code from begin to end, renumbering constant, global,
+// function and format operands.
+bool Linker::_append(size_t unit, size_t begin, size_t end) {
+  const ByteCode &code = *_units[unit];
+  Placement &placement = _placements[unit];
+  const size_t constant_base = placement.constant_base;
+  const size_t global_base = placement.global_base;
+  std::vector<size_t> &relocations = placement.relocations;
+  for (size_t offset = begin; offset < end;) {
+    const uint8_t *ip = code[offset];
+    const size_t length = instruction_length(ip);
+    const OpCode op_code = static_cast<OpCode>(
+        static_cast<OpCode>(*ip) == OpCode::Wide ? ip[1] : ip[0]);
+    relocations[offset] = _byte_code.Length();
+
+    switch (op_code) {
+    case OpCode::Constant:
+      if (!emit_indexed(_byte_code, op_code, constant_base + index(ip)))
+        return _error("Too many constants.", unit);
+      break;
+    case OpCode::GetGlobal:
+    case OpCode::SetGlobal:
+      if (!emit_indexed(_byte_code, op_code, global_base + index(ip)))
+        return _error("Too many globals.", unit);
+      break;
+    case OpCode::CallDirect:
+    case OpCode::TailCall:
+    case OpCode::CallMemo:
+      _byte_code.Write(*ip);
+      emit_short(_byte_code, _function_indices[unit][ip[1] | ip[2] << 8]);
+      _byte_code.Write(ip[3]);
+      break;
+    case OpCode::Format: {
+      const size_t format = placement.format_base + (ip[1] | ip[2] << 8);
+      if (format > std::numeric_limits<uint16_t>::max())
+        return _error("Too many format strings.", unit);
+      _byte_code.Write(*ip);
+      emit_short(_byte_code, format);
+      _byte_code.Write(ip[3]);
+    } break;
+    case OpCode::AddLocalConst:
+    case OpCode::SubtractLocalConst:
+    case OpCode::MultiplyLocalConst:
+    case OpCode::DivideLocalConst: {
+      const size_t constant = constant_base + ip[2];
+      if (constant <= std::numeric_limits<uint8_t>::max()) {
+        _byte_code.Write(*ip);
+        _byte_code.Write(ip[1]);
+        _byte_code.Write(constant);
+        break;
+      }
+      // the constant no longer fits the operand, so fall back to the stack
+      // form of the instruction
+      _byte_code.Write(static_cast<uint8_t>(OpCode::GetLocal));
+      _byte_code.Write(ip[1]);
+      if (!emit_indexed(_byte_code, OpCode::Constant, constant))
+        return _error("Too many constants.", unit);
+      _byte_code.Write(static_cast<uint8_t>(const_binary_op(op_code)));
+      placement.expanded = true;
+    } break;
+    default:
+      for (size_t i = 0; i < length; i++) {
+        _byte_code.Write(ip[i]);
+      }
+      break;
+    }
+    offset += length;
+  }
+  relocations[end] = _byte_code.Length();
+  return true;
+}
+
+// Adds the unit's functions and globals at their linked offsets.
+bool Linker::_declare(size_t unit) {
+  const ByteCode &code = *_units[unit];
+  const Placement &placement = _placements[unit];
+  const std::vector<size_t> &relocations = placement.relocations;
+  const size_t global_base = placement.global_base;
+  const int extra_stack = placement.expanded ? 1 : 0;
+  for (size_t i = 0; i < code.FunctionCount(); i++) {
+    const Function &function = code.GetFunctionInfo(i);
+    if (function.external)
+      continue;
+    // the last function ends where the initializers start, which have moved
+    const size_t end = function.end == code.GetGlobalInit()
+                           ? placement.function_end
+                           : relocations[function.end];
+    const int index =
+        _byte_code.AddFunction(function.name, relocations[function.offset],
+                               function.params, function.return_type,
+                               function.memoized);
+    _byte_code.SetMaxStack(index, function.max_stack + extra_stack);
+    _byte_code.SetFunctionEnd(index, end);
+  }
+
+  // globals are private to their unit, so only the root's keep their names
+  const bool root = unit + 1 == _units.size();
+  for (size_t i = 0; i < code.GlobalCount(); i++) {
+    const Global &global = code.GetGlobalInfo(i);
+    const std::string name =
+        root ? global.name : _unit_names[unit] + ":" + global.name;
+    const int index =
+        _byte_code.AddGlobal(name, global.type, relocations[global.offset]);
+    _byte_code.SetGlobalEnd(index, relocations[global.end]);
+  }
+  _byte_code.SetGlobalMaxStack(
+      std::max(_byte_code.GetGlobalMaxStack(),
+               code.GetGlobalMaxStack() + static_cast<int>(global_base) +
+                   extra_stack));
+  return true;
+}
+
+bool Linker::_error(const std::string &message, size_t unit) {
+  fprintf(stderr, "[%s] Link error: %s\n", _unit_names[unit].c_str(),
+          message.c_str());
+  return false;
+}
+} // namespace
+
+bool GuiSE::link(const std::vector<const ByteCode *> &units,
+                 const std::vector<std::string> &unit_names,
+                 ByteCode &byte_code) {
+  // a lone unit with nothing to resolve is already linked
+  if (units.size() == 1) {
+    bool external = false;
+    for (size_t i = 0; i < units[0]->FunctionCount(); i++) {
+      external |= units[0]->GetFunctionInfo(i).external;
+    }
+    if (!external) {
+      byte_code = *units[0];
+      return true;
+    }
+  }
+
+  ByteCode linked;
+  if (!Linker(units, unit_names, linked).Link())
+    return false;
+  byte_code = std::move(linked);
+  return true;
+}
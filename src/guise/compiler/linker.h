@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace GuiSE {
+class ByteCode;
+
+// Merges separately compiled units into byte_code, in the given order, which
+// is also the order their globals are initialized in. Each unit's constants,
+// globals and functions are appended and its operands renumbered to match,
+// and calls to external functions are bound to the unit defining them.
+// Globals are private to their unit: the last unit is the root, whose globals
+// keep their names, while those of the others are named
+// "<unit name>:<global name>". unit_names are also used in errors.
+bool link(const std::vector<const ByteCode *> &units,
+          const std::vector<std::string> &unit_names, ByteCode &byte_code);
+} // namespace GuiSE
@@ -0,0 +1,357 @@
+#include "module.h"
+
+#include "linker.h"
+#include "scanner.h"
+
+#include <guise/vm/byte_code.h>
+#include <guise/vm/image.h>
+#include <guise/vm/mapped_file.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace GuiSE;
+
+namespace fs = std::filesystem;
+
+namespace {
+struct Module {
+  std::string path;
+  // the file mapped in place, which tokens point into while it compiles
+  std::shared_ptr<const void> mapping;
+  const char *source = nullptr;
+  size_t source_length = 0;
+  bool read = false;
+  std::vector<std::string> import_paths; // as written in the source
+  std::vector<size_t> imports;
+  std::vector<Export> exports;
+  ByteCode byte_code;
+  bool built = false; // compiled or loaded from the cache
+};
+
+// Runs f(0) to f(count - 1) on up to threads threads, the calling one
+// included, each taking the next index as it finishes the last.
+template <typename F> void parallel_for(size_t count, unsigned threads, F f) {
+  std::atomic<size_t> next{0};
+  auto work = [&] {
+    for (size_t i; (i = next++) < count;) {
+      f(i);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < std::min<size_t>(threads, count); i++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+ValueType type_of(TokenType token_type) {
+  switch (token_type) {
+  case TokenType::TypeBool:
+    return ValueType::Bool;
+  case TokenType::TypeInt:
+    return ValueType::Int;
+  case TokenType::TypeNum:
+    return ValueType::Num;
+  case TokenType::TypeStr:
+    return ValueType::Str;
+  default:
+    return ValueType::Void;
+  }
+}
+
+// Reads a module's imports and function signatures from its tokens alone,
+// skipping function bodies and global initializers, so every interface is
+// known before any module is compiled. Malformed declarations are skipped
+// here and reported by the compile.
+void scan_interface(Module &module) {
+  Scanner scanner(module.source, module.source_length);
+  Token token;
+  TokenType type = scanner.ScanToken(token);
+  auto next = [&] { type = scanner.ScanToken(token); };
+
+  while (type != TokenType::Eof) {
+    if (type == TokenType::Import) {
+      next();
+      if (type == TokenType::String) {
+        module.import_paths.emplace_back(token.start + 1, token.length - 2);
+        next();
+      }
+      continue;
+    }
+    if (type != TokenType::Identifier) {
+      next();
+      continue;
+    }
+
+    Export fn;
+    fn.name = std::string(token.start, token.length);
+    next();
+    if (type != TokenType::Colon)
+      continue;
+    next();
+
+    while (type == TokenType::Identifier) {
+      next();
+      fn.params.push_back(type_of(type));
+      next();
+      if (type == TokenType::Colon)
+        next();
+    }
+
+    fn.memoized = type == TokenType::Memo;
+    if (fn.memoized)
+      next();
+    if (type != TokenType::Fn) {
+      while (type != TokenType::SemiColon && type != TokenType::Eof) {
+        next();
+      }
+      continue;
+    }
+
+    next();
+    fn.return_type = type_of(type);
+    if (fn.return_type != ValueType::Void)
+      next();
+    int depth = 0;
+    do {
+      if (type == TokenType::OpenBrace) {
+        depth++;
+      } else if (type == TokenType::CloseBrace) {
+        depth--;
+      }
+      next();
+    } while (depth > 0 && type != TokenType::Eof);
+    module.exports.push_back(std::move(fn));
+  }
+}
+
+uint64_t mix(uint64_t hash, uint64_t value) {
+  return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+}
+
+uint64_t interface_hash(const std::vector<Export> &exports) {
+  std::string signatures;
+  for (const auto &fn : exports) {
+    signatures += fn.name;
+    signatures += '(';
+    for (const ValueType type : fn.params) {
+      signatures += static_cast<char>(type);
+    }
+    signatures += ')';
+    signatures += static_cast<char>(fn.return_type);
+    signatures += fn.memoized ? 'm' : ' ';
+  }
+  return source_hash(signatures.data(), signatures.size());
+}
+
+// A unit is reusable while its source, the interfaces it imports and the
+// options it was compiled with are unchanged.
+uint64_t unit_key(const Module &module,
+                  const std::vector<std::unique_ptr<Module>> &modules,
+                  const CompileOptions &options) {
+  uint64_t key = source_hash(module.source, module.source_length);
+  key = mix(key, options.register_ops | options.peephole << 1 |
+                          options.fold_constants << 2);
+  for (const size_t import : module.imports) {
+    key = mix(key, interface_hash(modules[import]->exports));
+  }
+  return key;
+}
+
+std::string cache_path(const Module &module, const std::string &cache_dir) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.gsi",
+           static_cast<unsigned long long>(
+               source_hash(module.path.data(), module.path.size())));
+  return (fs::path(cache_dir) / name).string();
+}
+
+void read_module(Module &module) {
+  module.mapping = map_file(module.path.c_str(), module.source_length);
+  if (module.mapping == nullptr)
+    return;
+  module.source = static_cast<const char *>(module.mapping.get());
+  module.read = true;
+  scan_interface(module);
+}
+
+void compile_module(Module &module,
+                    const std::vector<std::unique_ptr<Module>> &modules,
+                    const ModuleOptions &options, std::atomic<size_t> &cached) {
+  uint64_t key = 0;
+  std::string cache_file;
+  if (!options.cache_dir.empty()) {
+    key = unit_key(module, modules, options.compile);
+    cache_file = cache_path(module, options.cache_dir);
+    uint64_t cached_key = 0;
+    if (is_image(cache_file.c_str()) &&
+        load_image(cache_file.c_str(), module.byte_code, &cached_key) &&
+        cached_key == key) {
+      module.built = true;
+      cached++;
+      return;
+    }
+    module.byte_code = ByteCode();
+  }
+
+  std::vector<Export> imports;
+  for (const size_t import : module.imports) {
+    const auto &exports = modules[import]->exports;
+    imports.insert(imports.end(), exports.begin(), exports.end());
+  }
+  module.built = compile_unit(module.source, module.source_length, imports,
+                              module.byte_code, options.compile);
+  if (!module.built) {
+    fprintf(stderr, "Could not compile module %s.\n", module.path.c_str());
+    return;
+  }
+
+  if (!cache_file.empty()) {
+    // written aside and renamed so a concurrent build never maps a partial
+    // image
+    const std::string temp_file = cache_file + ".tmp";
+    std::ofstream image(temp_file, std::ios::binary);
+    const bool written = write_image(module.byte_code, key, image);
+    image.close();
+    std::error_code error;
+    if (written) {
+      fs::rename(temp_file, cache_file, error);
+    } else {
+      fs::remove(temp_file, error);
+    }
+  }
+}
+
+void link_order(size_t index,
+                const std::vector<std::unique_ptr<Module>> &modules,
+                std::vector<bool> &visited, std::vector<size_t> &order) {
+  if (visited[index])
+    return;
+  visited[index] = true;
+  for (const size_t import : modules[index]->imports) {
+    link_order(import, modules, visited, order);
+  }
+  order.push_back(index);
+}
+
+// Reads root_file and every module it imports, directly or not, root first.
+// Modules are found a wave of imports at a time, each wave read and scanned
+// in parallel.
+bool find_modules(const std::string &root_file, unsigned threads,
+                  std::vector<std::unique_ptr<Module>> &modules) {
+  std::error_code error;
+  std::map<std::string, size_t> indices;
+  auto find_or_add = [&](const fs::path &path) {
+    const std::string key = fs::weakly_canonical(path, error).string();
+    auto it = indices.find(key);
+    if (it != indices.end())
+      return it->second;
+    modules.push_back(std::make_unique<Module>());
+    modules.back()->path = key;
+    indices[key] = modules.size() - 1;
+    return modules.size() - 1;
+  };
+
+  std::vector<size_t> wave = {find_or_add(fs::absolute(root_file, error))};
+  while (!wave.empty()) {
+    parallel_for(wave.size(), threads,
+                 [&](size_t i) { read_module(*modules[wave[i]]); });
+
+    std::vector<size_t> next_wave;
+    for (const size_t index : wave) {
+      if (!modules[index]->read) {
+        fprintf(stderr, "Could not read module %s.\n",
+                modules[index]->path.c_str());
+        return false;
+      }
+      const fs::path directory = fs::path(modules[index]->path).parent_path();
+      for (const auto &import_path : modules[index]->import_paths) {
+        const size_t count = modules.size();
+        const size_t import = find_or_add(directory / import_path);
+        if (modules.size() != count) {
+          next_wave.push_back(import);
+        }
+        auto &imports = modules[index]->imports;
+        if (import != index &&
+            std::find(imports.begin(), imports.end(), import) == imports.end())
+          imports.push_back(import);
+      }
+    }
+    wave = std::move(next_wave);
+  }
+  return true;
+}
+
+// Changes with the source of any module, in the order find_modules found
+// them.
+uint64_t sources_hash(const std::vector<std::unique_ptr<Module>> &modules) {
+  uint64_t hash = modules.size();
+  for (const auto &module : modules) {
+    hash = mix(hash, source_hash(module->source, module->source_length));
+  }
+  return hash;
+}
+} // namespace
+
+bool GuiSE::compile_modules(const std::string &root_file, ByteCode &byte_code,
+                            const ModuleOptions &options, ModuleStats *stats) {
+  const unsigned threads =
+      options.threads != 0 ? options.threads
+                           : std::max(1u, std::thread::hardware_concurrency());
+  std::error_code error;
+  if (!options.cache_dir.empty()) {
+    fs::create_directories(options.cache_dir, error);
+  }
+
+  std::vector<std::unique_ptr<Module>> modules;
+  if (!find_modules(root_file, threads, modules))
+    return false;
+
+  std::atomic<size_t> cached{0};
+  parallel_for(modules.size(), threads, [&](size_t i) {
+    compile_module(*modules[i], modules, options, cached);
+  });
+
+  if (stats != nullptr) {
+    stats->source_hash = sources_hash(modules);
+    stats->modules = modules.size();
+    stats->cached = cached;
+    stats->compiled = modules.size() - cached;
+  }
+
+  std::vector<size_t> order;
+  std::vector<bool> visited(modules.size());
+  link_order(0, modules, visited, order);
+
+  std::vector<const ByteCode *> units;
+  std::vector<std::string> unit_names;
+  for (const size_t index : order) {
+    if (!modules[index]->built)
+      return false;
+    units.push_back(&modules[index]->byte_code);
+    unit_names.push_back(modules[index]->path);
+  }
+  return link(units, unit_names, byte_code);
+}
+
+bool GuiSE::hash_modules(const std::string &root_file, uint64_t &hash,
+                         unsigned threads) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::unique_ptr<Module>> modules;
+  if (!find_modules(root_file, threads, modules))
+    return false;
+  hash = sources_hash(modules);
+  return true;
+}
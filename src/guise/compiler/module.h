@@ -0,0 +1,42 @@
+#pragma once
+
+#include "compiler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace GuiSE {
+class ByteCode;
+
+struct ModuleOptions {
+  CompileOptions compile;
+  // threads compiling modules, 0 for one per hardware thread
+  unsigned threads = 0;
+  // directory caching each module's compiled unit as an image, or empty
+  std::string cache_dir;
+};
+
+struct ModuleStats {
+  size_t modules = 0;
+  size_t compiled = 0;
+  size_t cached = 0; // loaded from the cache instead of compiled
+  uint64_t source_hash = 0; // as hash_modules computes it
+};
+
+// Builds root_file and every module it imports, directly or not, into
+// byte_code. A module imports another with `import "path.gs";`, relative to
+// its own directory, and can then call all of its functions. Each module is
+// compiled into its own unit in parallel, then the units are linked with
+// imported modules first. With a cache directory, a unit is only compiled
+// again when its source or the functions it imports have changed.
+bool compile_modules(const std::string &root_file, ByteCode &byte_code,
+                     const ModuleOptions &options = ModuleOptions(),
+                     ModuleStats *stats = nullptr);
+
+// Hashes the sources of root_file and every module it imports, so a program
+// built from them can tell when any has changed. Returns false if one cannot
+// be read.
+bool hash_modules(const std::string &root_file, uint64_t &hash,
+                  unsigned threads = 0);
+} // namespace GuiSE
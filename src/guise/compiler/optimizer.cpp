@@ -0,0 +1,178 @@
+#include "optimizer.h"
+
+#include <guise/compiler/types.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/opcode.h>
+
+#include <vector>
+
+using namespace GuiSE;
+
+namespace {
+// Wide-prefixed instructions are decoded as a single Wide instruction so no
+// pattern ever matches them.
+struct Instruction {
+  size_t offset;
+  size_t length;
+  OpCode op_code;
+  const uint8_t *operands;
+};
+
+bool is_op(const std::vector<Instruction> &code, size_t i, OpCode op_code) {
+  return i < code.size() && code[i].op_code == op_code;
+}
+
+OpCode local_const_op(OpCode op_code) {
+  switch (op_code) {
+  case OpCode::Add:
+    return OpCode::AddLocalConst;
+  case OpCode::Subtract:
+    return OpCode::SubtractLocalConst;
+  case OpCode::Multiply:
+    return OpCode::MultiplyLocalConst;
+  case OpCode::Divide:
+    return OpCode::DivideLocalConst;
+  default:
+    return OpCode::NoOp;
+  }
+}
+
+OpCode local_imm_op(OpCode op_code) {
+  switch (op_code) {
+  case OpCode::Add:
+    return OpCode::AddLocalImm;
+  case OpCode::Subtract:
+    return OpCode::SubtractLocalImm;
+  case OpCode::Multiply:
+    return OpCode::MultiplyLocalImm;
+  case OpCode::Divide:
+    return OpCode::DivideLocalImm;
+  default:
+    return OpCode::NoOp;
+  }
+}
+
+OpCode local_local_op(OpCode op_code) {
+  switch (op_code) {
+  case OpCode::Add:
+    return OpCode::AddLocalLocal;
+  case OpCode::Subtract:
+    return OpCode::SubtractLocalLocal;
+  case OpCode::Multiply:
+    return OpCode::MultiplyLocalLocal;
+  case OpCode::Divide:
+    return OpCode::DivideLocalLocal;
+  default:
+    return OpCode::NoOp;
+  }
+}
+
+OpCode negated_compare_op(OpCode op_code) {
+  switch (op_code) {
+  case OpCode::Equal:
+    return OpCode::NotEqual;
+  case OpCode::Less:
+    return OpCode::GreaterEqual;
+  case OpCode::Greater:
+    return OpCode::LessEqual;
+  default:
+    return OpCode::NoOp;
+  }
+}
+
+// Arithmetic operator starting at code[i], treating Negate+Add as Subtract.
+// Returns NoOp if there is none and sets length to the instructions used.
+OpCode arithmetic_op(const std::vector<Instruction> &code, size_t i,
+                     size_t &length) {
+  if (is_op(code, i, OpCode::Negate) && is_op(code, i + 1, OpCode::Add)) {
+    length = 2;
+    return OpCode::Subtract;
+  }
+  length = 1;
+  return i < code.size() ? code[i].op_code : OpCode::NoOp;
+}
+
+std::vector<Instruction> decode(const ByteCode &byte_code) {
+  std::vector<Instruction> code;
+  for (size_t offset = 0; offset < byte_code.Length();) {
+    const uint8_t *ip = byte_code[offset];
+    const size_t length = instruction_length(ip);
+    code.push_back({offset, length, static_cast<OpCode>(*ip), ip + 1});
+    offset += length;
+  }
+  return code;
+}
+} // namespace
+
+void GuiSE::optimize(ByteCode &byte_code) {
+  const std::vector<Instruction> code = decode(byte_code);
+
+  std::vector<uint8_t> out;
+  out.reserve(byte_code.Length());
+  std::vector<size_t> relocations(byte_code.Length() + 1, 0);
+
+  for (size_t i = 0; i < code.size();) {
+    const Instruction &instruction = code[i];
+    const size_t start = out.size();
+    size_t length = 0;
+    size_t op_length = 0;
+
+    if (instruction.op_code == OpCode::GetLocal && i + 1 < code.size()) {
+      // GetLocal a, Constant k | GetLocal b | PushSmallNum n | PushZero, <op>
+      //   ->  <op>LocalConst a k | <op>LocalLocal a b | <op>LocalImm a n
+      const Instruction &operand = code[i + 1];
+      const OpCode op_code = arithmetic_op(code, i + 2, op_length);
+      OpCode fused = OpCode::NoOp;
+      uint8_t b = 0;
+      switch (operand.op_code) {
+      case OpCode::Constant:
+        fused = local_const_op(op_code);
+        b = operand.operands[0];
+        break;
+      case OpCode::GetLocal:
+        fused = local_local_op(op_code);
+        b = operand.operands[0];
+        break;
+      case OpCode::PushSmallNum:
+        fused = local_imm_op(op_code);
+        b = operand.operands[0];
+        break;
+      case OpCode::PushZero:
+        fused = local_imm_op(op_code);
+        break;
+      default:
+        break;
+      }
+      if (fused != OpCode::NoOp) {
+        out.push_back(static_cast<uint8_t>(fused));
+        out.push_back(instruction.operands[0]);
+        out.push_back(b);
+        length = 2 + op_length;
+      }
+    } else if (instruction.op_code == OpCode::Negate &&
+               is_op(code, i + 1, OpCode::Add)) {
+      out.push_back(static_cast<uint8_t>(OpCode::Subtract));
+      length = 2;
+    } else if (is_op(code, i + 1, OpCode::Not)) {
+      const OpCode fused = negated_compare_op(instruction.op_code);
+      if (fused != OpCode::NoOp) {
+        out.push_back(static_cast<uint8_t>(fused));
+        length = 2;
+      }
+    }
+
+    if (length == 0) {
+      const uint8_t *bytes = instruction.operands - 1;
+      out.insert(out.end(), bytes, bytes + instruction.length);
+      length = 1;
+    }
+
+    for (size_t j = i; j < i + length; j++) {
+      relocations[code[j].offset] = start;
+    }
+    i += length;
+  }
+  relocations[byte_code.Length()] = out.size();
+
+  byte_code.Relocate(std::move(out), relocations);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace GuiSE {
+class ByteCode;
+
+// Peephole pass fusing common instruction sequences into superinstructions.
+void optimize(ByteCode &byte_code);
+} // namespace GuiSE
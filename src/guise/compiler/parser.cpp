@@ -5,6 +5,12 @@
 #include <guise/vm/object.h>
 #include <guise/vm/opcode.h>
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 using namespace GuiSE;
 
 namespace {
@@ -28,6 +34,41 @@ const char *expect_statment_semi_colon = "Expect ';' after statement.";
 
 const char *identifier_bound = "Identifier already bound to.";
 const char *identifier_not_bound = "Identifier is not bound to.";
+
+// _last_call while the return expression being parsed has made no call
+constexpr size_t no_call = std::numeric_limits<size_t>::max();
+
+constexpr double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Value of a number token: digits with an optional fraction. When the digits
+// fit 53 bits and there are at most 22 fraction digits, the digits and the
+// power of ten are both exact, so one correctly rounded division gives the
+// same num as a full parse; anything longer takes the full parse.
+Num parse_number(const char *chars, int length) {
+  uint64_t digits = 0;
+  int count = 0;
+  int fraction = -1;
+  for (int i = 0; i < length && count <= 19; i++) {
+    if (chars[i] == '.') {
+      fraction = 0;
+      continue;
+    }
+    digits = digits * 10 + (chars[i] - '0');
+    count++;
+    if (fraction >= 0)
+      fraction++;
+  }
+
+  if (count <= 19 && digits <= (uint64_t(1) << 53) && fraction <= 22)
+    return fraction > 0 ? digits / exact_powers_of_ten[fraction]
+                        : static_cast<Num>(digits);
+  Num value = 0;
+  std::from_chars(chars, chars + length, value);
+  return value;
+}
 } // namespace
 
 void Parser::_advance() {
@@ -88,6 +129,8 @@ Parser::ParsePrefixFn Parser::_get_prefix_rule(TokenType token_type) const {
     return &Parser::_grouping;
   case TokenType::String:
     return &Parser::_string;
+  case TokenType::Fn:
+    return &Parser::_format;
   case TokenType::Identifier:
     return &Parser::_identifier;
   }
@@ -129,6 +172,7 @@ const Parser::InfixRule &Parser::_get_infix_rule(TokenType token_type) const {
 }
 
 ValueType Parser::_parse_precedence(Precedence prec) {
+  const size_t start = _byte_code->Length();
   _advance();
   ParsePrefixFn prefix_rule = _get_prefix_rule(_prev_token_type);
   if (prefix_rule == nullptr) {
@@ -141,6 +185,7 @@ ValueType Parser::_parse_precedence(Precedence prec) {
   const InfixRule *infix_rule = &_get_infix_rule(_curr_token_type);
   while (prec <= infix_rule->prec) {
     _advance();
+    _operand_start = start;
     const ParseInfixFn rule = infix_rule->rule;
     type = (this->*rule)(type);
     infix_rule = &_get_infix_rule(_curr_token_type);
@@ -152,42 +197,63 @@ ValueType Parser::_parse_precedence(Precedence prec) {
 ValueType Parser::_binary(ValueType left_type) {
   TokenType op_token_type = _prev_token_type;
   const InfixRule &rule = _get_infix_rule(op_token_type);
+  const size_t left_start = _operand_start;
+  const size_t right_start = _byte_code->Length();
   ValueType right_type = _parse_precedence(
       static_cast<Precedence>(static_cast<int>(rule.prec) + 1));
 
+  const ValueType folded_type = _fold_binary(op_token_type, left_type,
+                                             right_type, left_start,
+                                             right_start);
+  if (folded_type != ValueType::Invalid)
+    return folded_type;
+
   ValueType expected_type = ValueType::Invalid;
   ValueType return_type = ValueType::Invalid;
   switch (op_token_type) {
   case TokenType::Plus:
     expected_type = ValueType::Num;
-    _emit_byte(OpCode::Add);
+    if (!_emit_register_op(OpCode::AddLocalLocal, left_start, right_start))
+      _emit_byte(OpCode::Add);
     return_type = ValueType::Num;
     break;
   case TokenType::Minus:
     expected_type = ValueType::Num;
-    _emit_byte(OpCode::Negate);
-    _emit_byte(OpCode::Add);
+    if (!_emit_register_op(OpCode::SubtractLocalLocal, left_start,
+                           right_start)) {
+      _emit_byte(OpCode::Negate);
+      _emit_byte(OpCode::Add);
+    }
     return_type = ValueType::Num;
     break;
   case TokenType::Star:
     expected_type = ValueType::Num;
-    _emit_byte(OpCode::Multiply);
+    if (!_emit_register_op(OpCode::MultiplyLocalLocal, left_start,
+                           right_start))
+      _emit_byte(OpCode::Multiply);
     return_type = ValueType::Num;
     break;
   case TokenType::Slash:
     expected_type = ValueType::Num;
-    _emit_byte(OpCode::Divide);
+    if (!_emit_register_op(OpCode::DivideLocalLocal, left_start,
+                           right_start))
+      _emit_byte(OpCode::Divide);
     return_type = ValueType::Num;
     break;
+  // strs are interned, so they compare by identity
   case TokenType::BangEqual:
-    expected_type = ValueType::Num;
-    _emit_byte(OpCode::Equal);
+    expected_type = left_type == ValueType::Str ? ValueType::Str
+                                                : ValueType::Num;
+    _emit_byte(expected_type == ValueType::Str ? OpCode::EqualStr
+                                               : OpCode::Equal);
     _emit_byte(OpCode::Not);
     return_type = ValueType::Bool;
     break;
   case TokenType::EqualEqual:
-    expected_type = ValueType::Num;
-    _emit_byte(OpCode::Equal);
+    expected_type = left_type == ValueType::Str ? ValueType::Str
+                                                : ValueType::Num;
+    _emit_byte(expected_type == ValueType::Str ? OpCode::EqualStr
+                                               : OpCode::Equal);
     return_type = ValueType::Bool;
     break;
   case TokenType::Greater:
@@ -230,24 +296,43 @@ ValueType Parser::_binary(ValueType left_type) {
   return return_type;
 }
 
-Parser::Parser(Scanner &scanner, ByteCode &byte_code)
-    : _scanner(scanner), _byte_code(&byte_code) {
+Parser::Parser(Scanner &scanner, SymbolTable &symbols, ByteCode &byte_code,
+               const CompileOptions &options)
+    : _scanner(scanner), _symbols(symbols), _byte_code(&byte_code),
+      _options(options) {
   _advance();
 }
 
+void Parser::Import(const std::vector<Export> &imports) {
+  _module = true;
+  for (const auto &fn : imports) {
+    const int index = _byte_code->AddExternalFunction(
+        fn.name, fn.params, fn.return_type, fn.memoized);
+    std::vector<Param> params;
+    for (const ValueType type : fn.params) {
+      params.emplace_back(Param{empty_symbol, type});
+    }
+    const SymbolId id = _symbols.Intern(fn.name.data(), fn.name.size());
+    if (!_scope_stack.AddFn(id, index, params, fn.return_type, fn.memoized)) {
+      fprintf(stderr, "Error: '%s' is imported more than once.\n",
+              fn.name.c_str());
+      _had_error = true;
+    }
+  }
+}
+
 bool Parser::Parse() {
-  _emit_byte(OpCode::Global);
   while (!_match(TokenType::Eof)) {
     _global_declaration();
   }
-  _emit_byte(OpCode::NoOp);
+  _place_global_init();
 
   return !_had_error;
 }
 
-bool Parser::_match_id(std::string &identifier) {
+bool Parser::_match_id(SymbolId &id) {
   if (_match(TokenType::Identifier)) {
-    identifier = std::string(_prev_token.start, _prev_token.length);
+    id = _prev_token.symbol;
     return true;
   }
   return false;
@@ -274,11 +359,11 @@ ValueType Parser::_type_specifier() {
 
 void Parser::_declaration() {
   _last_stmt_returned = false;
-  std::string identifier;
-  if (_match_id(identifier)) {
+  SymbolId id;
+  if (_match_id(id)) {
     if (_match(TokenType::Colon)) {
       ValueType type_spec = _type_specifier();
-      _var_declaration(identifier, type_spec);
+      _var_declaration(id, type_spec);
     } else {
       _id_stmt();
     }
@@ -290,15 +375,20 @@ void Parser::_declaration() {
     _synchronize();
 }
 
-void Parser::_var_declaration(std::string &identifier, ValueType type) {
-  _scope_stack.AddVar(identifier, type);
+void Parser::_var_declaration(SymbolId id, ValueType type) {
+  _scope_stack.AddVar(id, type);
   ValueType expr_type = _expr();
   _type_error(type, expr_type, expect_var_declaration_type);
   _consume(TokenType::SemiColon, "Expect ';'.");
 }
 
 void Parser::_global_declaration() {
-  BindingId id;
+  if (_match(TokenType::Import)) {
+    _import_declaration();
+    return;
+  }
+
+  SymbolId id = empty_symbol;
   if (!_match_id(id)) {
     _error_at_current("Expect identifier.");
   }
@@ -306,7 +396,7 @@ void Parser::_global_declaration() {
 
   // parse params: id : n int : m num...
   std::vector<Param> params;
-  BindingId param_id;
+  SymbolId param_id;
   while (_match_id(param_id)) {
     ValueType type = _type_specifier();
     if (type == ValueType::Void) {
@@ -318,27 +408,79 @@ void Parser::_global_declaration() {
   }
 
   // parse binding type
+  const bool memoized = _match(TokenType::Memo);
   if (_match(TokenType::Fn)) {
-    _fn_declaration(id, params);
+    _fn_declaration(id, params, memoized);
+  } else if (memoized) {
+    _error_at_current("Expect 'fn' after 'memo'.");
   } else if (ValueType type = _type_specifier(); type != ValueType::Void) {
+    // the initializer is parsed in place, then moved aside until
+    // _place_global_init puts all of them after the function code
+    const size_t start = _byte_code->Length();
+    const int depth = _scope_stack.get_global_count();
+    const int global = _byte_code->AddGlobal(
+        std::string(_symbols.Name(id)), type, _global_init_code.size());
     _var_declaration(id, type);
+    _byte_code->SetGlobalMaxStack(
+        std::max(_byte_code->GetGlobalMaxStack(),
+                 _max_stack_depth(start, depth)));
+    if (start < _byte_code->Length()) {
+      const uint8_t *code = (*_byte_code)[start];
+      _global_init_code.insert(_global_init_code.end(), code,
+                               code + (_byte_code->Length() - start));
+      _byte_code->Truncate(start);
+    }
+    _byte_code->SetGlobalEnd(global, _global_init_code.size());
   }
 
   if (_panic_mode)
     _synchronize();
 }
 
-void Parser::_fn_declaration(std::string &identifier,
-                             const std::vector<Param> &params) {
-  // denote end of previous global scope
-  _emit_byte(OpCode::Global);
+// Appends the global initializers after all function code as one block
+// ended by NoOp, so running the globals never steps through a function.
+void Parser::_place_global_init() {
+  const size_t init = _byte_code->Length();
+  for (const uint8_t byte : _global_init_code) {
+    _emit_byte(byte);
+  }
+  _emit_byte(OpCode::NoOp);
+  _byte_code->SetGlobalInit(init);
+  for (size_t i = 0; i < _byte_code->GlobalCount(); i++) {
+    const Global &global = _byte_code->GetGlobalInfo(i);
+    _byte_code->SetGlobalOffset(i, init + global.offset);
+    _byte_code->SetGlobalEnd(i, init + global.end);
+  }
+}
+
+void Parser::_import_declaration() {
+  if (!_module) {
+    _error("Imports need a module build.");
+  }
+  _consume(TokenType::String, "Expect module path string.");
+  _consume(TokenType::SemiColon, "Expect ';' after import.");
+
+  if (_panic_mode)
+    _synchronize();
+}
 
+void Parser::_fn_declaration(SymbolId id, const std::vector<Param> &params,
+                             bool memoized) {
   _return_type = _type_specifier();
-  const Int fn_ptr = _byte_code->Length();
-  _byte_code->AddFunction(identifier, fn_ptr);
+  _memoized = memoized;
+  const size_t start = _byte_code->Length();
+  std::vector<ValueType> param_types;
+  for (const auto &param : params) {
+    param_types.push_back(param.type);
+  }
+  const int index =
+      _byte_code->AddFunction(std::string(_symbols.Name(id)), start,
+                              param_types, _return_type, memoized);
+  if (index > std::numeric_limits<uint16_t>::max()) {
+    _error("Too many functions in one chunk.");
+  }
 
-  const uint8_t constant = _make_constant(fn_ptr);
-  if (!_scope_stack.AddFn(identifier, constant, params, _return_type)) {
+  if (!_scope_stack.AddFn(id, index, params, _return_type, memoized)) {
     _error(identifier_bound);
   }
 
@@ -348,22 +490,33 @@ void Parser::_fn_declaration(std::string &identifier,
   }
 
   _consume(TokenType::OpenBrace, "Expect '{'.");
+  _last_stmt_returned = false;
   while (!_match(TokenType::CloseBrace)) {
+    // statements after a return never run, so they are only checked
+    const bool dead = _last_stmt_returned;
+    const size_t dead_start = _byte_code->Length();
+    const size_t dead_constants = _byte_code->ConstantCount();
+    const size_t dead_formats = _byte_code->FormatCount();
     _declaration();
+    if (dead) {
+      _byte_code->Truncate(dead_start);
+      _byte_code->TruncateConstants(dead_constants);
+      _byte_code->TruncateFormats(dead_formats);
+      _last_stmt_returned = true;
+    }
   }
 
   if (!_last_stmt_returned) {
     if (_return_type == ValueType::Void) {
       _emit_byte(OpCode::StackUp);
-      _emit_byte(OpCode::Return);
+      _emit_byte(_memoized ? OpCode::ReturnMemo : OpCode::Return);
     } else {
       _error("Non-void return type must have explicit return.");
     }
   }
   _scope_stack.Pop();
-
-  // denote start of next global scope
-  _emit_byte(OpCode::Global);
+  _byte_code->SetMaxStack(index, _max_stack_depth(start, params.size()));
+  _byte_code->SetFunctionEnd(index, _byte_code->Length());
 }
 
 void Parser::_type_declaration() {}
@@ -407,16 +560,68 @@ void Parser::_return_stmt() {
   if (_return_type == ValueType::Void) {
     _emit_byte(OpCode::StackUp);
   } else {
+    _last_call = no_call;
     ValueType expr_type = _expr();
     _type_error(_return_type, expr_type, expect_return_expr_type);
+
+    // a call that ends the return expression is in tail position and can
+    // reuse this frame, unless this frame still has a result to cache
+    if (!_memoized && _last_call != no_call &&
+        _last_call + instruction_length((*_byte_code)[_last_call]) ==
+            _byte_code->Length()) {
+      _byte_code->Patch(_last_call, static_cast<uint8_t>(OpCode::TailCall));
+      _consume(TokenType::SemiColon, expect_statment_semi_colon);
+      _last_stmt_returned = true;
+      return;
+    }
   }
   _consume(TokenType::SemiColon, expect_statment_semi_colon);
-  _emit_byte(OpCode::Return);
+  _emit_byte(_memoized ? OpCode::ReturnMemo : OpCode::Return);
   _last_stmt_returned = true;
 }
 
 ValueType Parser::_expr() { return _parse_precedence(Precedence::Assignment); }
 
+// fn "text {expr} text": the slots are evaluated in order and a single
+// Format instruction builds the str from them and the text between.
+ValueType Parser::_format() {
+  if (_match(TokenType::String))
+    return _string();
+  _consume(TokenType::StringFnOpen, "Expect format string after 'fn'.");
+
+  FormatPlan plan;
+  for (;;) {
+    // the text between the opening and closing quote or brace
+    plan.text.append(_prev_token.start + 1, _prev_token.length - 2);
+    if (_prev_token_type == TokenType::StringFnClose)
+      break;
+
+    const ValueType type = _expr();
+    if (type == ValueType::Invalid || type == ValueType::Void)
+      _error("Expect value in format slot.");
+    plan.slots.push_back({static_cast<uint32_t>(plan.text.size()), type});
+    if (!_match(TokenType::StringFnMiddle) &&
+        !_match(TokenType::StringFnClose)) {
+      _error_at_current("Expect '}' after format slot.");
+      return ValueType::Str;
+    }
+  }
+
+  if (plan.slots.size() > std::numeric_limits<uint8_t>::max()) {
+    _error("Too many slots in one format string.");
+    return ValueType::Str;
+  }
+  const int index = _byte_code->AddFormat(std::move(plan));
+  if (index > std::numeric_limits<uint16_t>::max()) {
+    _error("Too many format strings in one chunk.");
+    return ValueType::Str;
+  }
+  _emit_byte(OpCode::Format);
+  _emit_short(index);
+  _emit_byte(_byte_code->GetFormat(index).slots.size());
+  return ValueType::Str;
+}
+
 ValueType Parser::_grouping() {
   ValueType type = _expr();
   _consume(TokenType::CloseParen, "Expect ')' after expression.");
@@ -425,32 +630,37 @@ ValueType Parser::_grouping() {
 
 ValueType Parser::_identifier() {
   bool is_global = false;
-  std::string identifier(_prev_token.start, _prev_token.length);
-  const FnBinding *fn_binding = _scope_stack.FindFn(identifier);
+  const SymbolId id = _prev_token.symbol;
+  const FnBinding *fn_binding = _scope_stack.FindFn(id);
   if (fn_binding != nullptr) {
     _emit_byte(OpCode::StackUp);
     for (const auto &param : fn_binding->get_params()) {
       ValueType type = _expr();
       _type_error(param.type, type, expect_fn_arg_type);
     }
-    _emit_byte(OpCode::Constant);
-    _emit_byte(fn_binding->get_constant());
-    _emit_byte(OpCode::Call);
+    if (fn_binding->is_memoized()) {
+      _emit_byte(OpCode::CallMemo);
+    } else {
+      _last_call = _byte_code->Length();
+      _emit_byte(OpCode::CallDirect);
+    }
+    _emit_short(fn_binding->get_index());
     _emit_byte(fn_binding->get_params().size());
     return fn_binding->get_return_type();
   }
 
-  const VarBinding *var_binding = _scope_stack.FindVar(identifier, is_global);
+  const VarBinding *var_binding = _scope_stack.FindVar(id, is_global);
   if (var_binding != nullptr) {
     if (_match(TokenType::Equal)) {
       ValueType expr_type = _expr();
       _type_error(var_binding->get_type(), expr_type,
                   expect_var_assignment_type);
-      _emit_byte(is_global ? OpCode::SetGlobal : OpCode::SetLocal);
+      _emit_indexed(is_global ? OpCode::SetGlobal : OpCode::SetLocal,
+                    var_binding->get_offset());
     } else {
-      _emit_byte(is_global ? OpCode::GetGlobal : OpCode::GetLocal);
+      _emit_indexed(is_global ? OpCode::GetGlobal : OpCode::GetLocal,
+                    var_binding->get_offset());
     }
-    _emit_byte(var_binding->get_offset());
     return var_binding->get_type();
   }
 
@@ -470,30 +680,46 @@ ValueType Parser::_literal() {
 }
 
 ValueType Parser::_number() {
-  Value value = strtod(_prev_token.start, nullptr);
-  _emit_constant(value);
-
+  _emit_number(parse_number(_prev_token.start, _prev_token.length));
   return ValueType::Num;
 }
 
 ValueType Parser::_string() {
-  _emit_constant(new Str(_prev_token.start + 1, _prev_token.length - 2));
+  Str *str =
+      _byte_code->NewStr(_prev_token.start + 1, _prev_token.length - 2);
+
+  // every use of an interned str shares one constant, unless the code that
+  // added it has since been dropped
+  auto it = _str_constants.find(str);
+  if (it != _str_constants.end() &&
+      static_cast<size_t>(it->second) < _byte_code->ConstantCount() &&
+      _byte_code->GetConstantType(it->second) == ValueType::Str &&
+      _byte_code->GetConstant(it->second).str == str) {
+    _emit_indexed(OpCode::Constant, it->second);
+  } else {
+    const int constant = _make_constant(str, ValueType::Str);
+    _str_constants[str] = constant;
+    _emit_indexed(OpCode::Constant, constant);
+  }
 
   return ValueType::Str;
 }
 
 ValueType Parser::_unary() {
   TokenType op_token_type = _prev_token_type;
+  const size_t start = _byte_code->Length();
   ValueType type = _parse_precedence(Precedence::Unary);
 
   switch (op_token_type) {
   case TokenType::Minus:
     _type_error(ValueType::Num, type, expect_operand_type);
-    _emit_byte(OpCode::Negate);
+    if (type != ValueType::Num || !_fold_unary(OpCode::Negate, start))
+      _emit_byte(OpCode::Negate);
     return ValueType::Num;
   case TokenType::Bang:
     _type_error(ValueType::Bool, type, expect_operand_type);
-    _emit_byte(OpCode::Not);
+    if (type != ValueType::Bool || !_fold_unary(OpCode::Not, start))
+      _emit_byte(OpCode::Not);
     return ValueType::Bool;
   }
 }
@@ -504,21 +730,377 @@ void Parser::_emit_byte(uint8_t byte) {
   _byte_code->Write(byte);
 }
 
-void Parser::_emit_constant(Value value) {
-  _emit_byte(OpCode::Constant);
-  _emit_byte(_make_constant(value));
+void Parser::_emit_short(uint16_t value) {
+  _emit_byte(static_cast<uint8_t>(value & 0xff));
+  _emit_byte(static_cast<uint8_t>(value >> 8));
 }
 
-uint8_t Parser::_make_constant(Value value) {
+void Parser::_emit_constant(Value value, ValueType type) {
+  _emit_indexed(OpCode::Constant, _make_constant(value, type));
+}
+
+void Parser::_emit_literal(Value value, ValueType type) {
+  if (type == ValueType::Bool) {
+    _emit_byte(value.bool_ ? OpCode::True : OpCode::False);
+  } else {
+    _emit_number(value.num);
+  }
+}
+
+void Parser::_emit_number(Num value) {
+  // small whole numbers are encoded inline and never touch the constant pool;
+  // -0 keeps its sign in the pool
+  if (value == 0 && !std::signbit(value)) {
+    _emit_byte(OpCode::PushZero);
+  } else if (value >= std::numeric_limits<int8_t>::min() &&
+             value <= std::numeric_limits<int8_t>::max() &&
+             value == std::trunc(value) && value != 0) {
+    _emit_byte(OpCode::PushSmallNum);
+    _emit_byte(static_cast<int8_t>(value));
+  } else {
+    _emit_constant(value, ValueType::Num);
+  }
+}
+
+void Parser::_emit_indexed(OpCode op_code, int index) {
+  if (index <= std::numeric_limits<uint8_t>::max()) {
+    _emit_byte(op_code);
+    _emit_byte(index);
+  } else if (index <= std::numeric_limits<uint16_t>::max()) {
+    _emit_byte(OpCode::Wide);
+    _emit_byte(op_code);
+    _emit_short(index);
+  } else {
+    _error("Too many variables in one chunk.");
+  }
+}
+
+int Parser::_make_constant(Value value, ValueType type) {
   GUISE_ASSERT(_byte_code != nullptr)
 
-  int constant = _byte_code->AddConstant(value);
-  if (constant > std::numeric_limits<uint8_t>::max()) {
+  int constant = _byte_code->AddConstant(value, type);
+  if (constant > std::numeric_limits<uint16_t>::max()) {
     _error("Too many constants in one chunk.");
     return 0;
   }
 
-  return static_cast<uint8_t>(constant);
+  return constant;
+}
+
+// Replaces the two operand loads emitted since left_start with a single
+// register instruction when both operands are plain local reads.
+bool Parser::_emit_register_op(OpCode op_code, size_t left_start,
+                               size_t right_start) {
+  if (!_options.register_ops)
+    return false;
+
+  uint8_t a, b;
+  if (!_local_load(left_start, right_start, a) ||
+      !_local_load(right_start, _byte_code->Length(), b))
+    return false;
+
+  _byte_code->Truncate(left_start);
+  _emit_byte(op_code);
+  _emit_byte(a);
+  _emit_byte(b);
+  return true;
+}
+
+bool Parser::_local_load(size_t start, size_t end, uint8_t &slot) const {
+  if (end - start != 2)
+    return false;
+
+  const uint8_t *code = (*_byte_code)[start];
+  if (static_cast<OpCode>(code[0]) != OpCode::GetLocal)
+    return false;
+
+  slot = code[1];
+  return true;
+}
+
+// Deepest operand stack reached by the straight-line code emitted since start,
+// given the depth on entry.
+int Parser::_max_stack_depth(size_t start, int depth) const {
+  int max_depth = depth;
+  for (size_t offset = start; offset < _byte_code->Length();) {
+    const uint8_t *ip = (*_byte_code)[offset];
+    OpCode op_code = static_cast<OpCode>(*ip);
+    if (op_code == OpCode::Wide)
+      op_code = static_cast<OpCode>(ip[1]);
+
+    const OpInfo &info = op_info(op_code);
+    // calls and formats consume the values counted by their last operand; a
+    // call's result lands in the StackUp slot
+    depth -= info.pops < 0 ? ip[3] : info.pops;
+    depth += info.pushes;
+    max_depth = std::max(max_depth, depth);
+    offset += instruction_length(ip);
+  }
+  return max_depth;
+}
+
+// Folds an operation on two literals into its result, and drops an operand
+// that cannot change the result. Returns the result type, or Invalid if the
+// operation is left for _binary to emit. The operations keep their runtime
+// semantics: != is !(==) and >= is !(<) for NaN, and only identities exact
+// for every value, -0 and NaN included, are dropped.
+ValueType Parser::_fold_binary(TokenType op_token_type, ValueType left_type,
+                               ValueType right_type, size_t left_start,
+                               size_t right_start) {
+  if (!_options.fold_constants)
+    return ValueType::Invalid;
+  const bool logical =
+      op_token_type == TokenType::And || op_token_type == TokenType::Or;
+  const ValueType operand_type = logical ? ValueType::Bool : ValueType::Num;
+  if (left_type != operand_type || right_type != operand_type)
+    return ValueType::Invalid;
+
+  const size_t end = _byte_code->Length();
+  Value a, b;
+  int a_constant, b_constant;
+  const bool a_literal = _literal_load(left_start, right_start, a, a_constant);
+  const bool b_literal = _literal_load(right_start, end, b, b_constant);
+
+  if (a_literal && b_literal) {
+    Value result;
+    ValueType type = ValueType::Bool;
+    switch (op_token_type) {
+    case TokenType::Plus:
+      result = a.num + b.num;
+      type = ValueType::Num;
+      break;
+    case TokenType::Minus:
+      result = a.num - b.num;
+      type = ValueType::Num;
+      break;
+    case TokenType::Star:
+      result = a.num * b.num;
+      type = ValueType::Num;
+      break;
+    case TokenType::Slash:
+      result = a.num / b.num;
+      type = ValueType::Num;
+      break;
+    case TokenType::BangEqual:
+      result = !(a.num == b.num);
+      break;
+    case TokenType::EqualEqual:
+      result = a.num == b.num;
+      break;
+    case TokenType::Greater:
+      result = a.num > b.num;
+      break;
+    case TokenType::GreaterEqual:
+      result = !(a.num < b.num);
+      break;
+    case TokenType::Less:
+      result = a.num < b.num;
+      break;
+    case TokenType::LessEqual:
+      result = !(a.num > b.num);
+      break;
+    case TokenType::Or:
+      result = a.bool_ || b.bool_;
+      break;
+    case TokenType::And:
+      result = a.bool_ && b.bool_;
+      break;
+    default:
+      return ValueType::Invalid;
+    }
+
+    // the literals' pool entries were made for them alone and are the newest
+    _drop_code(left_start, end);
+    const int constant = a_constant != -1 ? a_constant : b_constant;
+    if (constant != -1)
+      _byte_code->TruncateConstants(constant);
+    _emit_literal(result, type);
+    return type;
+  }
+
+  auto is_num = [](bool literal, Value value, Num num) {
+    return literal && value.num == num && !std::signbit(value.num);
+  };
+  switch (op_token_type) {
+  case TokenType::Minus: {
+    if (is_num(b_literal, b, 0)) {
+      _drop_code(right_start, end);
+      return ValueType::Num;
+    }
+    // a - -b is a + b
+    const size_t last = _last_instruction(right_start);
+    if (last != end &&
+        static_cast<OpCode>(*(*_byte_code)[last]) == OpCode::Negate) {
+      _drop_code(last, end);
+      _emit_byte(OpCode::Add);
+      return ValueType::Num;
+    }
+    break;
+  }
+  case TokenType::Star:
+    if (is_num(b_literal, b, 1)) {
+      _drop_code(right_start, end);
+      return ValueType::Num;
+    }
+    if (is_num(a_literal, a, 1)) {
+      _drop_code(left_start, right_start);
+      return ValueType::Num;
+    }
+    break;
+  case TokenType::Slash:
+    if (is_num(b_literal, b, 1)) {
+      _drop_code(right_start, end);
+      return ValueType::Num;
+    }
+    break;
+  case TokenType::And:
+  case TokenType::Or: {
+    // true and x is x, false and x is false; or the other way around. Both
+    // operands always run, so the other one is only dropped without side
+    // effects.
+    const bool identity = op_token_type == TokenType::And;
+    if (b_literal && b.bool_ == identity) {
+      _drop_code(right_start, end);
+      return ValueType::Bool;
+    }
+    if (a_literal && a.bool_ == identity) {
+      _drop_code(left_start, right_start);
+      return ValueType::Bool;
+    }
+    if ((a_literal && _is_pure(right_start, end)) ||
+        (b_literal && _is_pure(left_start, right_start))) {
+      _drop_code(left_start, end);
+      _emit_literal(!identity, ValueType::Bool);
+      return ValueType::Bool;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  return ValueType::Invalid;
+}
+
+// Folds - or ! applied to a literal, and cancels one applied twice.
+bool Parser::_fold_unary(OpCode op_code, size_t start) {
+  if (!_options.fold_constants)
+    return false;
+
+  Value value;
+  int constant;
+  if (_literal_load(start, _byte_code->Length(), value, constant)) {
+    _drop_code(start, _byte_code->Length());
+    if (constant != -1)
+      _byte_code->TruncateConstants(constant);
+    if (op_code == OpCode::Negate) {
+      _emit_number(-value.num);
+    } else {
+      _emit_literal(!value.bool_, ValueType::Bool);
+    }
+    return true;
+  }
+
+  // the operand's last instruction is its outermost operation
+  const size_t last = _last_instruction(start);
+  if (last != _byte_code->Length() &&
+      static_cast<OpCode>(*(*_byte_code)[last]) == op_code) {
+    _drop_code(last, _byte_code->Length());
+    return true;
+  }
+  return false;
+}
+
+// Reads the value loaded by the code from start to end if that code is a
+// single num or bool literal. constant is its pool index, or -1 if the value
+// is encoded inline.
+bool Parser::_literal_load(size_t start, size_t end, Value &value,
+                           int &constant) const {
+  if (start == end)
+    return false;
+  const uint8_t *code = (*_byte_code)[start];
+  if (start + instruction_length(code) != end)
+    return false;
+
+  constant = -1;
+  switch (static_cast<OpCode>(code[0])) {
+  case OpCode::PushZero:
+    value = Num(0);
+    return true;
+  case OpCode::PushSmallNum:
+    value = static_cast<Num>(static_cast<int8_t>(code[1]));
+    return true;
+  case OpCode::True:
+    value = true;
+    return true;
+  case OpCode::False:
+    value = false;
+    return true;
+  case OpCode::Constant:
+    constant = code[1];
+    break;
+  case OpCode::Wide:
+    if (static_cast<OpCode>(code[1]) != OpCode::Constant)
+      return false;
+    constant = code[2] | code[3] << 8;
+    break;
+  default:
+    return false;
+  }
+
+  if (_byte_code->GetConstantType(constant) != ValueType::Num)
+    return false;
+  value = _byte_code->GetConstant(constant);
+  return true;
+}
+
+// True if the code from start to end only computes a value, so dropping it
+// changes nothing else.
+bool Parser::_is_pure(size_t start, size_t end) const {
+  for (size_t offset = start; offset < end;) {
+    const uint8_t *ip = (*_byte_code)[offset];
+    OpCode op_code = static_cast<OpCode>(*ip);
+    if (op_code == OpCode::Wide)
+      op_code = static_cast<OpCode>(ip[1]);
+
+    switch (op_code) {
+    case OpCode::CallDirect:
+    case OpCode::CallMemo:
+    case OpCode::TailCall:
+    case OpCode::SetLocal:
+    case OpCode::SetGlobal:
+    case OpCode::Log:
+      return false;
+    default:
+      break;
+    }
+    offset += instruction_length(ip);
+  }
+  return true;
+}
+
+// Offset of the last instruction emitted since start, or the code length if
+// there is none.
+size_t Parser::_last_instruction(size_t start) const {
+  size_t last = _byte_code->Length();
+  for (size_t offset = start; offset < _byte_code->Length();) {
+    last = offset;
+    offset += instruction_length((*_byte_code)[offset]);
+  }
+  return last;
+}
+
+// Removes the code from start to end, moving any code after it down.
+void Parser::_drop_code(size_t start, size_t end) {
+  const size_t length = _byte_code->Length();
+  std::vector<uint8_t> tail;
+  if (end < length)
+    tail.assign((*_byte_code)[end], (*_byte_code)[0] + length);
+  _byte_code->Truncate(start);
+  for (const uint8_t byte : tail) {
+    _emit_byte(byte);
+  }
+  if (_last_call != no_call && _last_call >= end)
+    _last_call -= end - start;
 }
 
 void Parser::_error_at(TokenType token_type, const Token &token,
@@ -1,12 +1,17 @@
 #pragma once
 
 #include "binding.h"
+#include "compiler.h"
 #include "scanner.h"
+#include "symbol.h"
 #include "types.h"
 
+#include <unordered_map>
+
 namespace GuiSE {
 class ByteCode;
 class Scanner;
+enum class OpCode : uint8_t;
 
 enum class Precedence {
   None,
@@ -24,7 +29,13 @@ enum class Precedence {
 
 class Parser {
 public:
-  Parser(Scanner &scanner, ByteCode &byte_code);
+  // symbols must be the table scanner interns identifiers into.
+  Parser(Scanner &scanner, SymbolTable &symbols, ByteCode &byte_code,
+         const CompileOptions &options);
+
+  // Binds functions from other modules, compiling this source as a module
+  // whose import statements are already resolved. Call before Parse.
+  void Import(const std::vector<Export> &imports);
 
   bool Parse();
 
@@ -34,15 +45,17 @@ private:
   bool _check(TokenType token_type);
   void _consume(TokenType token_type, const char *message);
   bool _match(TokenType token_type);
-  bool _match_id(std::string &identifier);
+  bool _match_id(SymbolId &id);
 
   // declarations
   ValueType _type_specifier();
   void _declaration();
-  void _var_declaration(std::string &identifier, ValueType value_t);
+  void _var_declaration(SymbolId id, ValueType value_t);
   void _global_declaration();
-  void _fn_declaration(std::string &identifier,
-                       const std::vector<Param> &params);
+  void _place_global_init();
+  void _import_declaration();
+  void _fn_declaration(SymbolId id, const std::vector<Param> &params,
+                       bool memoized);
   void _type_declaration();
   void _cmpt_declaration();
 
@@ -56,6 +69,7 @@ private:
   // expressions
   ValueType _binary(ValueType left_type);
   ValueType _expr();
+  ValueType _format();
   ValueType _grouping();
   ValueType _identifier();
   ValueType _literal();
@@ -83,8 +97,27 @@ private:
     _emit_byte(static_cast<uint8_t>(byte));
   }
 
-  void _emit_constant(Value value);
-  uint8_t _make_constant(Value value);
+  void _emit_short(uint16_t value);
+  void _emit_constant(Value value, ValueType type);
+  void _emit_indexed(OpCode op_code, int index);
+  int _make_constant(Value value, ValueType type);
+  bool _emit_register_op(OpCode op_code, size_t left_start,
+                         size_t right_start);
+  bool _local_load(size_t start, size_t end, uint8_t &slot) const;
+  int _max_stack_depth(size_t start, int depth) const;
+
+  // constant folding
+  ValueType _fold_binary(TokenType op_token_type, ValueType left_type,
+                         ValueType right_type, size_t left_start,
+                         size_t right_start);
+  bool _fold_unary(OpCode op_code, size_t start);
+  bool _literal_load(size_t start, size_t end, Value &value,
+                     int &constant) const;
+  bool _is_pure(size_t start, size_t end) const;
+  size_t _last_instruction(size_t start) const;
+  void _emit_literal(Value value, ValueType type);
+  void _emit_number(Num value);
+  void _drop_code(size_t start, size_t end);
 
   // errors
   void _error_at(TokenType token_type, const Token &token, const char *message);
@@ -96,7 +129,9 @@ private:
   void _type_error(ValueType expected, ValueType value_t, const char *message);
 
   Scanner &_scanner;
+  SymbolTable &_symbols;
   ByteCode *_byte_code;
+  CompileOptions _options;
   Token _curr_token;
   Token _prev_token;
   TokenType _curr_token_type = TokenType::Invalid;
@@ -104,7 +139,14 @@ private:
   bool _had_error = false;
   bool _panic_mode = false;
   ValueType _return_type = ValueType::Invalid;
+  bool _memoized = false; // the current function caches its results
+  bool _module = false;   // compiling one module of a multi-file build
   bool _last_stmt_returned = false;
+  size_t _operand_start = 0; // code offset of the current left operand
+  size_t _last_call = 0;     // code offset of the last CallDirect
   ScopeStack _scope_stack;
+  // global initializers, set aside in order until Parse places them
+  std::vector<uint8_t> _global_init_code;
+  std::unordered_map<const Str *, int> _str_constants;
 };
 } // namespace GuiSE
\ No newline at end of file
@@ -1,5 +1,19 @@
 #include "scanner.h"
 
+#include <bitset>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GUISE_SCANNER_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace GuiSE;
+
 namespace {
 // Error strings
 const char *error_unexpected_character = "Unexpected character.";
@@ -10,12 +24,210 @@ bool is_digit(char c) { return c >= '0' && c <= '9'; }
 bool is_alpha(char c) {
   return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
 }
+
+// Index of the lowest set bit of a non-zero mask.
+int first_set(unsigned mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+int count_set(unsigned mask) { return std::bitset<32>(mask).count(); }
+
+// blanks tested one at a time before a run of them is tested by chunks
+constexpr int blank_run = 8;
+
+#ifdef GUISE_SCANNER_SSE2
+using Chunk = __m128i;
+constexpr int chunk_size = 16;
+
+Chunk load(const char *chars) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(chars));
+}
+
+// One bit per char of chunk, set where the char equals c.
+unsigned equal(Chunk chunk, char c) {
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)));
+}
+
+// Set where the char is from first to last. Chars from 0x80 on compare as
+// negative, so they are never in an ASCII range.
+unsigned in_range(Chunk chunk, char first, char last) {
+  return _mm_movemask_epi8(
+      _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(first - 1)),
+                    _mm_cmplt_epi8(chunk, _mm_set1_epi8(last + 1))));
+}
+#endif
+
+// Char classes for skip_run: a scalar test, and where vectors are available
+// the same test on a whole chunk.
+struct IdentifierChar {
+  static bool test(char c) { return is_alpha(c) || is_digit(c); }
+#ifdef GUISE_SCANNER_SSE2
+  static unsigned test(Chunk chunk) {
+    // setting bit 5 folds upper case onto lower case
+    const Chunk lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    return in_range(lower, 'a', 'z') | in_range(chunk, '0', '9');
+  }
+#endif
+};
+
+struct CommentChar {
+  static bool test(char c) { return c != '\n'; }
+#ifdef GUISE_SCANNER_SSE2
+  static unsigned test(Chunk chunk) { return ~equal(chunk, '\n'); }
+#endif
+};
+
+struct StringChar {
+  static bool test(char c) { return c != '"' && c != '\n'; }
+#ifdef GUISE_SCANNER_SSE2
+  static unsigned test(Chunk chunk) {
+    return ~(equal(chunk, '"') | equal(chunk, '\n'));
+  }
+#endif
+};
+
+struct StringFnChar {
+  static bool test(char c) { return c != '"' && c != '{' && c != '\n'; }
+#ifdef GUISE_SCANNER_SSE2
+  static unsigned test(Chunk chunk) {
+    return ~(equal(chunk, '"') | equal(chunk, '{') | equal(chunk, '\n'));
+  }
+#endif
+};
+
+// Returns the first char from chars on, or end, that is not of Class.
+template <typename Class>
+const char *skip_run(const char *chars, const char *end) {
+#ifdef GUISE_SCANNER_SSE2
+  for (; end - chars >= chunk_size; chars += chunk_size) {
+    const unsigned stop = ~Class::test(load(chars)) & 0xffff;
+    if (stop != 0)
+      return chars + first_set(stop);
+  }
+#endif
+  while (chars < end && Class::test(*chars))
+    chars++;
+  return chars;
+}
+
+bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Like skip_run for spaces, tabs, carriage returns and newlines, adding the
+// newlines skipped to lines. Most runs between tokens are empty or a single
+// space, where a predicted branch per char beats waiting on a chunk, so
+// chunks only take over past the first few chars.
+const char *skip_blanks(const char *chars, const char *end, int &lines) {
+  const char *prefix_end = end - chars > blank_run ? chars + blank_run : end;
+  for (; chars < prefix_end; chars++) {
+    if (*chars == '\n') {
+      lines++;
+    } else if (!is_blank(*chars)) {
+      return chars;
+    }
+  }
+#ifdef GUISE_SCANNER_SSE2
+  for (; end - chars >= chunk_size; chars += chunk_size) {
+    const Chunk chunk = load(chars);
+    const unsigned newlines = equal(chunk, '\n');
+    const unsigned stop = ~(newlines | equal(chunk, ' ') |
+                            equal(chunk, '\t') | equal(chunk, '\r')) &
+                          0xffff;
+    if (stop != 0) {
+      // only the newlines before the first other char
+      lines += count_set(newlines & (stop - 1) & ~stop);
+      return chars + first_set(stop);
+    }
+    lines += count_set(newlines);
+  }
+#endif
+  for (; chars < end; chars++) {
+    if (*chars == '\n') {
+      lines++;
+    } else if (!is_blank(*chars)) {
+      break;
+    }
+  }
+  return chars;
+}
+
+// Keyword text is padded with NULs to a whole word, so an identifier is
+// matched with one compare of its first word_size chars.
+constexpr int word_size = 8;
+
+struct Keyword {
+  char text[word_size] = {};
+  int length = 0;
+  TokenType type = TokenType::Identifier;
+};
+
+constexpr Keyword keywords[] = {
+    {"and", 3, TokenType::And},       {"bool", 4, TokenType::TypeBool},
+    {"cmpt", 4, TokenType::Cmpt},     {"else", 4, TokenType::Else},
+    {"false", 5, TokenType::False},   {"fn", 2, TokenType::Fn},
+    {"for", 3, TokenType::For},       {"if", 2, TokenType::If},
+    {"import", 6, TokenType::Import}, {"int", 3, TokenType::TypeInt},
+    {"log", 3, TokenType::Log},       {"memo", 4, TokenType::Memo},
+    {"num", 3, TokenType::TypeNum},   {"or", 2, TokenType::Or},
+    {"return", 6, TokenType::Return}, {"str", 3, TokenType::TypeStr},
+    {"true", 4, TokenType::True},     {"type", 4, TokenType::Type},
+    {"while", 5, TokenType::While},
+};
+constexpr int min_keyword_length = 2;
+constexpr int max_keyword_length = 6;
+constexpr size_t keyword_slots = 32;
+
+// Perfect hash of the keywords over their first two chars and length, which
+// identifiers too short or long to be one never reach. If a new keyword
+// collides, keyword_table fails to build and the multipliers need changing.
+constexpr size_t keyword_hash(const char *chars, int length) {
+  return (static_cast<unsigned char>(chars[0]) * 3 +
+          static_cast<unsigned char>(chars[1]) * 30 + length) &
+         (keyword_slots - 1);
+}
+
+struct KeywordTable {
+  Keyword slots[keyword_slots];
+  // masks[length] keeps the first length chars of a word
+  char masks[max_keyword_length + 1][word_size] = {};
+  bool perfect = true;
+};
+
+constexpr KeywordTable make_keyword_table() {
+  KeywordTable table;
+  for (const Keyword &keyword : keywords) {
+    Keyword &slot = table.slots[keyword_hash(keyword.text, keyword.length)];
+    if (slot.length != 0)
+      table.perfect = false;
+    slot = keyword;
+  }
+  for (int length = 0; length <= max_keyword_length; length++) {
+    for (int i = 0; i < length; i++)
+      table.masks[length][i] = '\xff';
+  }
+  return table;
+}
+
+constexpr KeywordTable keyword_table = make_keyword_table();
+static_assert(keyword_table.perfect, "two keywords share a keyword_hash slot");
+
+uint64_t load_word(const char *chars) {
+  uint64_t word;
+  memcpy(&word, chars, sizeof(word));
+  return word;
+}
 } // namespace
 
-using namespace GuiSE;
+Scanner::Scanner(const char *source) : Scanner(source, strlen(source)) {}
 
-Scanner::Scanner(const char *source)
-    : _source(source), _start(_source), _current(_source) {}
+Scanner::Scanner(const char *source, size_t length, SymbolTable *symbols)
+    : _source(source), _start(_source), _current(_source),
+      _end(source + length), _symbols(symbols) {}
 
 TokenType Scanner::ScanToken(Token &token) {
   _skip_whitespace();
@@ -32,14 +244,22 @@ TokenType Scanner::ScanToken(Token &token) {
   if (is_digit(c))
     return _integer_or_number(token);
 
-  // Scanning string fn
+  // Scanning string fn. A slot may hold another format string, so each open
+  // one counts the braces opened in its current slot, and only a '}' that
+  // matches none of them ends the slot.
   if (_last_token_fn && c == '"') {
-    _scanning_string_fn = true;
+    _format_braces.push_back(0);
     return _string_fn(token);
   }
 
-  if (_scanning_string_fn && c == '}')
-    return _string_fn(token);
+  if (!_format_braces.empty()) {
+    if (c == '}' && _format_braces.back() == 0)
+      return _string_fn(token);
+    if (c == '{')
+      _format_braces.back()++;
+    else if (c == '}')
+      _format_braces.back()--;
+  }
 
   if (c == '"')
     return _string(token);
@@ -101,7 +321,7 @@ TokenType Scanner::_error_token(const char *error, Token &token) {
   return TokenType::Error;
 }
 
-bool Scanner::_is_at_end() { return *_current == '\0'; }
+bool Scanner::_is_at_end() { return _current == _end; }
 
 TokenType Scanner::_make_token(TokenType token_type, Token &token) {
   token.start = _start;
@@ -137,42 +357,23 @@ bool Scanner::_match(char expected) {
   return true;
 }
 
-char Scanner::_peek() { return *_current; }
+// Past the end both read as NUL, which no token continues with.
+char Scanner::_peek() { return _is_at_end() ? '\0' : *_current; }
 
-char Scanner::_peek_next() { return _current[1]; }
+char Scanner::_peek_next() { return _end - _current > 1 ? _current[1] : '\0'; }
 
 void Scanner::_skip_whitespace() {
   for (;;) {
-    char c = _peek();
-    switch (c) {
-    case ' ':
-    case '\r':
-    case '\t':
-      _advance();
-      break;
-    case '\n':
-      _line++;
-      _advance();
-      break;
-    case '#':
-      while (_peek() != '\n' && !_is_at_end())
-        _advance();
-      break;
-    default:
+    _current = skip_blanks(_current, _end, _line);
+    if (_peek() != '#')
       return;
-    }
+    _current = skip_run<CommentChar>(_current, _end);
   }
 }
 
 TokenType Scanner::_string(Token &token) {
-  while (!_is_at_end() && _peek() != '"') {
-    if (_peek() == '\n')
-      return _error_token(error_unterminated_string, token);
-
-    _advance();
-  }
-
-  if (_is_at_end())
+  _current = skip_run<StringChar>(_current, _end);
+  if (_is_at_end() || _peek() == '\n')
     return _error_token(error_unterminated_string, token);
 
   _advance();
@@ -180,15 +381,11 @@ TokenType Scanner::_string(Token &token) {
 }
 
 TokenType GuiSE::Scanner::_string_fn(Token &token) {
-  while (!_is_at_end() && _peek() != '"' && _peek() != '{') {
-    if (_peek() == '\n')
-      return _error_token(error_unterminated_string, token);
-
-    _advance();
-  }
-
-  if (_is_at_end())
+  _current = skip_run<StringFnChar>(_current, _end);
+  if (_is_at_end() || _peek() == '\n') {
+    _format_braces.pop_back();
     return _error_token(error_unterminated_string, token);
+  }
 
   TokenType token_type = TokenType::String;
   switch (*_start) {
@@ -208,82 +405,44 @@ TokenType GuiSE::Scanner::_string_fn(Token &token) {
   }
 
   if (token_type == TokenType::String || token_type == TokenType::StringFnClose)
-    _scanning_string_fn = false;
+    _format_braces.pop_back();
 
   _advance();
   return _make_token(token_type, token);
 }
 
 TokenType Scanner::_identifier(Token &token) {
-  while (is_alpha(_peek()) || is_digit(_peek()))
-    _advance();
-  return _make_token(_identifier_t(), token);
+  _current = skip_run<IdentifierChar>(_current, _end);
+  const TokenType token_type = _make_token(_identifier_t(), token);
+  if (_symbols != nullptr && token_type == TokenType::Identifier)
+    token.symbol = _symbols->Intern(_start, _current - _start);
+  return token_type;
 }
 
+// Identifiers come in no predictable order, so away from the end of the
+// source the lookup takes no branches: the identifier is masked to the
+// length of the keyword in its slot, which also matches an empty slot's
+// zero length to no identifier.
 TokenType Scanner::_identifier_t() {
-  switch (_start[0]) {
-  case 'a':
-    return _check_keyword(1, 2, "nd", TokenType::And);
-  case 'b':
-    return _check_keyword(1, 3, "ool", TokenType::TypeBool);
-  case 'c':
-    return _check_keyword(1, 3, "mpt", TokenType::Cmpt);
-  case 'e':
-    return _check_keyword(1, 3, "lse", TokenType::Else);
-  case 'f':
-    if (_current - _start > 1) {
-      switch (_start[1]) {
-      case 'a':
-        return _check_keyword(2, 3, "lse", TokenType::False);
-      case 'o':
-        return _check_keyword(2, 1, "r", TokenType::For);
-      case 'n':
-        return _check_keyword(2, 0, "", TokenType::Fn);
-      }
-    }
-    break;
-  case 'i':
-    if (_current - _start > 1) {
-      switch (_start[1]) {
-      case 'f':
-        return _check_keyword(2, 0, "", TokenType::If);
-      case 'n':
-        return _check_keyword(2, 1, "t", TokenType::TypeInt);
-      }
-    }
-    return _check_keyword(1, 1, "f", TokenType::If);
-  case 'l':
-    return _check_keyword(1, 2, "og", TokenType::Log);
-  case 'n':
-    return _check_keyword(1, 2, "um", TokenType::TypeNum);
-  case 'o':
-    return _check_keyword(1, 1, "r", TokenType::Or);
-  case 's':
-    return _check_keyword(1, 2, "tr", TokenType::TypeStr);
-  case 'r':
-    return _check_keyword(1, 5, "eturn", TokenType::Return);
-  case 't':
-    if (_current - _start > 1) {
-      switch (_start[1]) {
-      case 'r':
-        return _check_keyword(2, 2, "ue", TokenType::True);
-      case 'y':
-        return _check_keyword(2, 2, "pe", TokenType::Type);
-      }
-    }
-    break;
-  case 'w':
-    return _check_keyword(1, 4, "hile", TokenType::While);
+  const int length = _current - _start;
+  if (_end - _start >= word_size) {
+    const Keyword &keyword =
+        keyword_table.slots[keyword_hash(_start, length)];
+    const uint64_t word =
+        load_word(_start) & load_word(keyword_table.masks[keyword.length]);
+    const bool match =
+        (word == load_word(keyword.text)) & (keyword.length == length);
+    return match ? keyword.type : TokenType::Identifier;
   }
-  return TokenType::Identifier;
-}
 
-TokenType Scanner::_check_keyword(int start, int length, const char *rest,
-                                  TokenType type) {
-  if (_current - _start == start + length &&
-      memcmp(_start + start, rest, length) == 0) {
-    return type;
+  if (length < min_keyword_length || length > max_keyword_length)
+    return TokenType::Identifier;
+  const Keyword &keyword = keyword_table.slots[keyword_hash(_start, length)];
+  if (keyword.length != length)
+    return TokenType::Identifier;
+  for (int i = 0; i < length; i++) {
+    if (keyword.text[i] != _start[i])
+      return TokenType::Identifier;
   }
-
-  return TokenType::Identifier;
+  return keyword.type;
 }
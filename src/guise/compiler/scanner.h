@@ -1,6 +1,10 @@
 #pragma once
 
+#include "symbol.h"
+
+#include <cstddef>
 #include <string>
+#include <vector>
 
 namespace GuiSE {
 enum class TokenType {
@@ -41,10 +45,12 @@ enum class TokenType {
   Cmpt,
   Else,
   If,
+  Import,
   False,
   Fn,
   For,
   Log,
+  Memo,
   Or,
   Return,
   True,
@@ -65,11 +71,17 @@ struct Token {
   const char *start = nullptr;
   int length = 0;
   int line = -1;
+  // the interned name of an identifier, when scanned with a symbol table
+  SymbolId symbol = empty_symbol;
 };
 
 class Scanner {
 public:
   Scanner(const char *source);
+  // Scans the length chars at source, which need not end in a NUL and may
+  // contain NULs of their own. With symbols, identifiers are interned into
+  // it as they are scanned.
+  Scanner(const char *source, size_t length, SymbolTable *symbols = nullptr);
 
   TokenType ScanToken(Token &token);
 
@@ -87,16 +99,17 @@ private:
   TokenType _string_fn(Token &token);
   TokenType _identifier(Token &token);
   TokenType _identifier_t();
-  TokenType _check_keyword(int start, int length, const char *rest,
-                           TokenType type);
 
   void _skip_whitespace();
 
   const char *_source;
   const char *_start;
   const char *_current;
+  const char *_end; // one past the last char
+  SymbolTable *_symbols;
   int _line = 1;
-  bool _scanning_string_fn = false;
+  // by open format string, innermost last: braces opened in its current slot
+  std::vector<int> _format_braces;
   bool _last_token_fn = false;
 };
 } // namespace GuiSE
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "symbol.h"
+
+#include <cstring>
+
+using namespace GuiSE;
+
+namespace {
+// FNV-1a
+uint32_t hash_of(const char *chars, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ static_cast<uint8_t>(chars[i])) * 16777619u;
+  }
+  return hash;
+}
+} // namespace
+
+SymbolTable::SymbolTable() : _slots(64) { Intern("", 0); }
+
+SymbolId SymbolTable::Intern(const char *chars, size_t length) {
+  const uint32_t hash = hash_of(chars, length);
+  size_t mask = _slots.size() - 1;
+  size_t i = hash & mask;
+  for (; _slots[i].id != 0; i = (i + 1) & mask) {
+    const Slot &slot = _slots[i];
+    if (slot.hash != hash)
+      continue;
+    const std::string_view name = _names[slot.id - 1];
+    if (name.size() == length && memcmp(name.data(), chars, length) == 0)
+      return slot.id - 1;
+  }
+
+  const SymbolId id = _names.size();
+  _names.emplace_back(chars, length);
+  if (_names.size() * 2 > _slots.size()) {
+    _grow();
+    mask = _slots.size() - 1;
+    i = hash & mask;
+    while (_slots[i].id != 0)
+      i = (i + 1) & mask;
+  }
+  _slots[i] = {hash, id + 1};
+  return id;
+}
+
+void SymbolTable::_grow() {
+  std::vector<Slot> slots(_slots.size() * 2);
+  const size_t mask = slots.size() - 1;
+  for (const Slot &slot : _slots) {
+    if (slot.id == 0)
+      continue;
+    size_t i = slot.hash & mask;
+    while (slots[i].id != 0)
+      i = (i + 1) & mask;
+    slots[i] = slot;
+  }
+  _slots = std::move(slots);
+}
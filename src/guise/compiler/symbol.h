@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace GuiSE {
+// Dense id of an interned name, usable as an index into per-symbol arrays.
+using SymbolId = uint32_t;
+
+// The empty name, interned first. A declaration whose name is missing binds
+// it, so parsing can go on after the error.
+constexpr SymbolId empty_symbol = 0;
+
+// Interns names as SymbolIds, so equal names get the same id and are then
+// compared and looked up as integers. Names are not copied: their chars must
+// outlive the table, as a source outlives its compile.
+class SymbolTable {
+public:
+  SymbolTable();
+
+  SymbolId Intern(const char *chars, size_t length);
+
+  inline std::string_view Name(SymbolId id) const { return _names[id]; }
+  inline size_t Count() const { return _names.size(); }
+
+private:
+  void _grow();
+
+  struct Slot {
+    uint32_t hash = 0;
+    SymbolId id = 0; // 1 + the id, 0 for an empty slot
+  };
+
+  std::vector<Slot> _slots; // open addressing, at most half full
+  std::vector<std::string_view> _names;
+};
+} // namespace GuiSE
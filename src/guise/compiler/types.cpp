@@ -31,7 +31,8 @@ void GuiSE::log_value(ValueType type, Value value) {
     printf("%d", value.int_);
     break;
   case ValueType::Str:
-    printf("%s", value.str->get_chars());
+    // by length, as a str from the source may hold NULs
+    fwrite(value.str->get_chars(), 1, value.str->get_length(), stdout);
     break;
   }
 }
\ No newline at end of file
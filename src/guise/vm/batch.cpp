@@ -0,0 +1,381 @@
+#include "batch.h"
+#include "batch_kernels.h"
+#include "byte_code.h"
+#include "opcode.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GUISE_BATCH_SSE2
+#endif
+
+using namespace GuiSE;
+
+namespace {
+#ifdef GUISE_BATCH_SSE2
+struct Sse2Lanes {
+  using V = __m128d;
+  static constexpr size_t width = 2;
+  static V load(const double *p) { return _mm_loadu_pd(p); }
+  static void store(double *p, V v) { _mm_storeu_pd(p, v); }
+  static V add(V a, V b) { return _mm_add_pd(a, b); }
+  static V subtract(V a, V b) { return _mm_sub_pd(a, b); }
+  static V multiply(V a, V b) { return _mm_mul_pd(a, b); }
+  static V divide(V a, V b) { return _mm_div_pd(a, b); }
+  // ordered compares, false for NaN like the scalar ones
+  static V equal(V a, V b) { return _mm_and_pd(_mm_cmpeq_pd(a, b), one()); }
+  static V greater(V a, V b) { return _mm_and_pd(_mm_cmpgt_pd(a, b), one()); }
+  static V less(V a, V b) { return _mm_and_pd(_mm_cmplt_pd(a, b), one()); }
+  static V and_(V a, V b) { return _mm_mul_pd(a, b); }
+  static V or_(V a, V b) { return _mm_max_pd(a, b); }
+  static V negate(V a) { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+  static V not_(V a) { return _mm_sub_pd(one(), a); }
+  static V one() { return _mm_set1_pd(1.0); }
+};
+#endif
+
+const BatchKernels *select_kernels() {
+#ifdef GUISE_BATCH_AVX
+  if (__builtin_cpu_supports("avx"))
+    return avx_batch_kernels();
+#endif
+#ifdef GUISE_BATCH_SSE2
+  return make_batch_kernels<Sse2Lanes>("sse2");
+#else
+  return make_batch_kernels<ScalarLanes>("scalar");
+#endif
+}
+
+const BatchKernels *kernels() {
+  static const BatchKernels *selected = select_kernels();
+  return selected;
+}
+
+bool is_lane_type(ValueType type) {
+  return type == ValueType::Num || type == ValueType::Bool;
+}
+
+double lane_value(ValueType type, Value value) {
+  return type == ValueType::Bool ? (value.bool_ ? 1.0 : 0.0) : value.num;
+}
+} // namespace
+
+Batch::Batch() : _kernels(kernels()) {}
+
+void Batch::set_byte_code(const ByteCode *byte_code) {
+  _byte_code = byte_code;
+  _runnable.assign(byte_code->FunctionCount(), -1);
+}
+
+// Checks callees before their callers with a worklist rather than recursion,
+// as call chains can be deeper than the native stack.
+bool Batch::CanRun(int function) {
+  std::vector<int> pending;
+  if (_runnable[function] == -1)
+    pending.push_back(function);
+  while (!pending.empty()) {
+    const int current = pending.back();
+    int callee = -1;
+    const int8_t runnable = _check(current, callee);
+    if (runnable == -1) {
+      _runnable[current] = 2;
+      pending.push_back(callee);
+      continue;
+    }
+    _runnable[current] = runnable;
+    pending.pop_back();
+  }
+  return _runnable[function] == 1;
+}
+
+void Batch::Run(int function, const Value *globals, const Num *const *args,
+                size_t rows, Num *results) {
+  _globals = globals;
+  const Function &info = _byte_code->GetFunctionInfo(function);
+  for (size_t row = 0; row < rows; row += BATCH_LANES) {
+    const size_t lanes = std::min<size_t>(BATCH_LANES, rows - row);
+    // slot 0 takes the result, as a StackUp would for a call
+    _reserve(1 + info.arity);
+    for (size_t p = 0; p < info.arity; p++) {
+      std::copy(args[p] + row, args[p] + row + lanes, _slot(1 + p));
+    }
+    _call(function, 1, lanes);
+    std::copy(_slot(0), _slot(0) + lanes, results + row);
+  }
+}
+
+// Returns whether function can run, or -1 with the callee to check first.
+int8_t Batch::_check(int function, int &callee) {
+  const Function &info = _byte_code->GetFunctionInfo(function);
+  if (info.external || !is_lane_type(info.return_type))
+    return false;
+  for (const ValueType type : info.params) {
+    if (!is_lane_type(type))
+      return false;
+  }
+
+  const uint8_t *ip = (*_byte_code)[info.offset];
+  const uint8_t *end = (*_byte_code)[0] + info.end;
+  for (; ip < end; ip += instruction_length(ip)) {
+    const bool wide = ip[0] == static_cast<uint8_t>(OpCode::Wide);
+    const OpCode op_code = static_cast<OpCode>(ip[wide]);
+    auto index = [&] { return wide ? ip[2] | ip[3] << 8 : ip[1]; };
+
+    switch (op_code) {
+    case OpCode::Constant:
+      if (!is_lane_type(_byte_code->GetConstantType(index())))
+        return false;
+      break;
+    case OpCode::GetGlobal:
+      if (!is_lane_type(_byte_code->GetGlobalInfo(index()).type))
+        return false;
+      break;
+    case OpCode::AddLocalConst:
+    case OpCode::SubtractLocalConst:
+    case OpCode::MultiplyLocalConst:
+    case OpCode::DivideLocalConst:
+      if (!is_lane_type(_byte_code->GetConstantType(ip[2])))
+        return false;
+      break;
+    case OpCode::CallDirect:
+    case OpCode::TailCall:
+    case OpCode::CallMemo:
+      callee = ip[1] | ip[2] << 8;
+      // without control flow a recursive call never returns, so a function
+      // reached again while being checked is rejected
+      if (_runnable[callee] == -1)
+        return -1;
+      if (_runnable[callee] != 1)
+        return false;
+      break;
+    case OpCode::NoOp:
+    case OpCode::SetGlobal:
+    case OpCode::Log:
+    case OpCode::TypeArg:
+    case OpCode::Format:
+      return false;
+    default:
+      break;
+    }
+  }
+  return true;
+}
+
+// Calls keep their caller's ip and fp on _frames instead of recursing. Lanes
+// are addressed by slot index rather than pointer, as a callee may grow them.
+void Batch::_call(int function, size_t fp, size_t lanes) {
+  const BatchKernels &k = *_kernels;
+  const uint8_t *ip = nullptr;
+  size_t sp = 0;
+  auto enter = [&](int callee) {
+    const Function &info = _byte_code->GetFunctionInfo(callee);
+    _reserve(fp + std::max<int>(info.max_stack, info.arity));
+    ip = (*_byte_code)[info.offset];
+    sp = fp + info.arity;
+  };
+  _frames.clear();
+  enter(function);
+
+  auto fill = [&](size_t slot, double value) {
+    std::fill_n(_slot(slot), lanes, value);
+  };
+  auto copy = [&](size_t from, size_t to) {
+    std::copy_n(_slot(from), lanes, _slot(to));
+  };
+  auto binary = [&](BatchBinaryFn f) {
+    sp--;
+    f(_slot(sp - 1), _slot(sp - 1), _slot(sp), lanes);
+  };
+  auto negated = [&](BatchBinaryFn f) {
+    binary(f);
+    k.not_(_slot(sp - 1), _slot(sp - 1), lanes);
+  };
+  // register forms compute into the slot they push, which first takes the
+  // constant or immediate operand
+  auto local_local = [&](BatchBinaryFn f) {
+    f(_slot(sp), _slot(fp + ip[0]), _slot(fp + ip[1]), lanes);
+    sp++;
+    ip += 2;
+  };
+  auto local_value = [&](BatchBinaryFn f, double value) {
+    fill(sp, value);
+    f(_slot(sp), _slot(fp + ip[0]), _slot(sp), lanes);
+    sp++;
+    ip += 2;
+  };
+  auto local_const = [&](BatchBinaryFn f) {
+    local_value(f, _byte_code->GetConstant(ip[1]).num);
+  };
+  auto local_imm = [&](BatchBinaryFn f) {
+    local_value(f, static_cast<int8_t>(ip[1]));
+  };
+  auto indexed = [&](OpCode op_code, int index) {
+    switch (op_code) {
+    case OpCode::Constant:
+      fill(sp++, lane_value(_byte_code->GetConstantType(index),
+                            _byte_code->GetConstant(index)));
+      break;
+    case OpCode::GetGlobal:
+      fill(sp++, lane_value(_byte_code->GetGlobalInfo(index).type,
+                            _globals[index]));
+      break;
+    case OpCode::GetLocal:
+      copy(fp + index, sp++);
+      break;
+    case OpCode::SetLocal:
+      copy(sp - 1, fp + index);
+      break;
+    default:
+      break;
+    }
+  };
+
+  for (;;) {
+    const OpCode op_code = static_cast<OpCode>(*ip++);
+    switch (op_code) {
+    case OpCode::Constant:
+    case OpCode::GetGlobal:
+    case OpCode::GetLocal:
+    case OpCode::SetLocal:
+      indexed(op_code, *ip++);
+      break;
+    case OpCode::Wide:
+      indexed(static_cast<OpCode>(ip[0]), ip[1] | ip[2] << 8);
+      ip += 3;
+      break;
+    case OpCode::CallDirect:
+    case OpCode::CallMemo: {
+      const int callee = ip[0] | ip[1] << 8;
+      _frames.push_back({ip + 3, fp});
+      fp = sp - ip[2];
+      enter(callee);
+      break;
+    }
+    case OpCode::TailCall: {
+      // the arguments move down to fp so the callee returns into our slot
+      const int callee = ip[0] | ip[1] << 8;
+      const int arg_count = ip[2];
+      for (int i = 0; i < arg_count; i++) {
+        copy(sp - arg_count + i, fp + i);
+      }
+      enter(callee);
+      break;
+    }
+    case OpCode::StackUp:
+      sp++;
+      break;
+    case OpCode::Pop:
+      sp--;
+      break;
+    case OpCode::Add:
+      binary(k.add);
+      break;
+    case OpCode::Subtract:
+      binary(k.subtract);
+      break;
+    case OpCode::Multiply:
+      binary(k.multiply);
+      break;
+    case OpCode::Divide:
+      binary(k.divide);
+      break;
+    case OpCode::Negate:
+      k.negate(_slot(sp - 1), _slot(sp - 1), lanes);
+      break;
+    case OpCode::True:
+      fill(sp++, 1.0);
+      break;
+    case OpCode::False:
+    case OpCode::PushZero:
+      fill(sp++, 0.0);
+      break;
+    case OpCode::PushSmallNum:
+      fill(sp++, static_cast<int8_t>(*ip++));
+      break;
+    case OpCode::Not:
+      k.not_(_slot(sp - 1), _slot(sp - 1), lanes);
+      break;
+    case OpCode::Equal:
+      binary(k.equal);
+      break;
+    case OpCode::Greater:
+      binary(k.greater);
+      break;
+    case OpCode::Less:
+      binary(k.less);
+      break;
+    case OpCode::NotEqual:
+      negated(k.equal);
+      break;
+    case OpCode::GreaterEqual:
+      negated(k.less);
+      break;
+    case OpCode::LessEqual:
+      negated(k.greater);
+      break;
+    case OpCode::And:
+      binary(k.and_);
+      break;
+    case OpCode::Or:
+      binary(k.or_);
+      break;
+    case OpCode::AddLocalLocal:
+      local_local(k.add);
+      break;
+    case OpCode::SubtractLocalLocal:
+      local_local(k.subtract);
+      break;
+    case OpCode::MultiplyLocalLocal:
+      local_local(k.multiply);
+      break;
+    case OpCode::DivideLocalLocal:
+      local_local(k.divide);
+      break;
+    case OpCode::AddLocalConst:
+      local_const(k.add);
+      break;
+    case OpCode::SubtractLocalConst:
+      local_const(k.subtract);
+      break;
+    case OpCode::MultiplyLocalConst:
+      local_const(k.multiply);
+      break;
+    case OpCode::DivideLocalConst:
+      local_const(k.divide);
+      break;
+    case OpCode::AddLocalImm:
+      local_imm(k.add);
+      break;
+    case OpCode::SubtractLocalImm:
+      local_imm(k.subtract);
+      break;
+    case OpCode::MultiplyLocalImm:
+      local_imm(k.multiply);
+      break;
+    case OpCode::DivideLocalImm:
+      local_imm(k.divide);
+      break;
+    case OpCode::Return:
+    case OpCode::ReturnMemo:
+      copy(sp - 1, fp - 1);
+      if (_frames.empty())
+        return;
+      sp = fp;
+      ip = _frames.back().ip;
+      fp = _frames.back().fp;
+      _frames.pop_back();
+      break;
+    default:
+      // rejected by _check
+      return;
+    }
+  }
+}
+
+void Batch::_reserve(size_t slots) {
+  if (_lanes.size() < slots * BATCH_LANES)
+    _lanes.resize(slots * BATCH_LANES);
+}
+
+const char *GuiSE::batch_isa() { return kernels()->isa; }
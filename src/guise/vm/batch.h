@@ -0,0 +1,55 @@
+#pragma once
+
+#include <guise/compiler/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// rows run together, every stack slot holding one lane per row
+#define BATCH_LANES 256
+
+namespace GuiSE {
+class ByteCode;
+struct BatchKernels;
+
+struct BatchFrame {
+  const uint8_t *ip = nullptr;
+  size_t fp = 0; // slot index
+};
+
+// Runs a num/bool function over many rows of arguments at once. Each stack
+// slot becomes a column of lanes and every instruction is applied to the
+// whole column with SIMD kernels picked for the CPU at startup. Bools are
+// lanes of 0 or 1. Only functions free of side effects qualify: no logging,
+// no global writes and no str values, calling only functions that qualify.
+class Batch {
+public:
+  Batch();
+
+  void set_byte_code(const ByteCode *byte_code);
+  bool CanRun(int function);
+  // Calls function once per row, argument p of row r read from args[p][r],
+  // and stores each result in results[r]. globals are read as the VM holds
+  // them, by global slot. Memoized functions run uncached.
+  void Run(int function, const Value *globals, const Num *const *args,
+           size_t rows, Num *results);
+
+private:
+  int8_t _check(int function, int &callee);
+  void _call(int function, size_t fp, size_t lanes);
+  void _reserve(size_t slots);
+  inline double *_slot(size_t slot) { return &_lanes[slot * BATCH_LANES]; }
+
+  const ByteCode *_byte_code = nullptr;
+  const BatchKernels *_kernels;
+  const Value *_globals = nullptr;
+  // by function: -1 unchecked, 0 no, 1 yes, 2 being checked
+  std::vector<int8_t> _runnable;
+  std::vector<BatchFrame> _frames;
+  std::vector<double> _lanes;
+};
+
+// Name of the kernels in use: "avx", "sse2" or "scalar".
+const char *batch_isa();
+} // namespace GuiSE
@@ -0,0 +1,37 @@
+#include "batch_kernels.h"
+
+#include <immintrin.h>
+
+using namespace GuiSE;
+
+namespace {
+struct AvxLanes {
+  using V = __m256d;
+  static constexpr size_t width = 4;
+  static V load(const double *p) { return _mm256_loadu_pd(p); }
+  static void store(double *p, V v) { _mm256_storeu_pd(p, v); }
+  static V add(V a, V b) { return _mm256_add_pd(a, b); }
+  static V subtract(V a, V b) { return _mm256_sub_pd(a, b); }
+  static V multiply(V a, V b) { return _mm256_mul_pd(a, b); }
+  static V divide(V a, V b) { return _mm256_div_pd(a, b); }
+  // ordered compares, false for NaN like the scalar ones
+  static V equal(V a, V b) {
+    return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ), one());
+  }
+  static V greater(V a, V b) {
+    return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ), one());
+  }
+  static V less(V a, V b) {
+    return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ), one());
+  }
+  static V and_(V a, V b) { return _mm256_mul_pd(a, b); }
+  static V or_(V a, V b) { return _mm256_max_pd(a, b); }
+  static V negate(V a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+  static V not_(V a) { return _mm256_sub_pd(one(), a); }
+  static V one() { return _mm256_set1_pd(1.0); }
+};
+} // namespace
+
+const BatchKernels *GuiSE::avx_batch_kernels() {
+  return make_batch_kernels<AvxLanes>("avx");
+}
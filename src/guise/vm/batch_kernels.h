@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace GuiSE {
+using BatchBinaryFn = void (*)(double *dst, const double *a, const double *b,
+                               size_t n);
+using BatchUnaryFn = void (*)(double *dst, const double *a, size_t n);
+
+// Lane kernels for one instruction set. Bools are lanes of 0 or 1, so the
+// comparisons produce 0 or 1 and the logic operations are arithmetic on them.
+// Every kernel may be called with dst equal to a or b.
+struct BatchKernels {
+  const char *isa;
+  BatchBinaryFn add;
+  BatchBinaryFn subtract;
+  BatchBinaryFn multiply;
+  BatchBinaryFn divide;
+  BatchBinaryFn equal;
+  BatchBinaryFn greater;
+  BatchBinaryFn less;
+  BatchBinaryFn and_;
+  BatchBinaryFn or_;
+  BatchUnaryFn negate;
+  BatchUnaryFn not_;
+};
+
+// Defined in batch_avx.cpp, which is the only file built with AVX enabled.
+const BatchKernels *avx_batch_kernels();
+
+// The kernels are built from a lanes type, wrapping one instruction set's
+// vector type V of width doubles. These templates are included by files
+// built with different instruction sets, so they stay internal to each.
+namespace {
+struct ScalarLanes {
+  using V = double;
+  static constexpr size_t width = 1;
+  static V load(const double *p) { return *p; }
+  static void store(double *p, V v) { *p = v; }
+  static V add(V a, V b) { return a + b; }
+  static V subtract(V a, V b) { return a - b; }
+  static V multiply(V a, V b) { return a * b; }
+  static V divide(V a, V b) { return a / b; }
+  static V equal(V a, V b) { return a == b ? 1.0 : 0.0; }
+  static V greater(V a, V b) { return a > b ? 1.0 : 0.0; }
+  static V less(V a, V b) { return a < b ? 1.0 : 0.0; }
+  static V and_(V a, V b) { return a * b; }
+  static V or_(V a, V b) { return std::max(a, b); }
+  static V negate(V a) { return -a; }
+  static V not_(V a) { return 1.0 - a; }
+};
+
+template <typename Lanes, typename Lanes::V (*op)(typename Lanes::V,
+                                                   typename Lanes::V),
+          double (*scalar_op)(double, double)>
+void binary_kernel(double *dst, const double *a, const double *b, size_t n) {
+  size_t i = 0;
+  for (; i + Lanes::width <= n; i += Lanes::width) {
+    Lanes::store(dst + i, op(Lanes::load(a + i), Lanes::load(b + i)));
+  }
+  for (; i < n; i++) {
+    dst[i] = scalar_op(a[i], b[i]);
+  }
+}
+
+template <typename Lanes, typename Lanes::V (*op)(typename Lanes::V),
+          double (*scalar_op)(double)>
+void unary_kernel(double *dst, const double *a, size_t n) {
+  size_t i = 0;
+  for (; i + Lanes::width <= n; i += Lanes::width) {
+    Lanes::store(dst + i, op(Lanes::load(a + i)));
+  }
+  for (; i < n; i++) {
+    dst[i] = scalar_op(a[i]);
+  }
+}
+
+template <typename Lanes> const BatchKernels *make_batch_kernels(const char *isa) {
+  using S = ScalarLanes;
+  static const BatchKernels kernels = {
+      isa,
+      binary_kernel<Lanes, Lanes::add, S::add>,
+      binary_kernel<Lanes, Lanes::subtract, S::subtract>,
+      binary_kernel<Lanes, Lanes::multiply, S::multiply>,
+      binary_kernel<Lanes, Lanes::divide, S::divide>,
+      binary_kernel<Lanes, Lanes::equal, S::equal>,
+      binary_kernel<Lanes, Lanes::greater, S::greater>,
+      binary_kernel<Lanes, Lanes::less, S::less>,
+      binary_kernel<Lanes, Lanes::and_, S::and_>,
+      binary_kernel<Lanes, Lanes::or_, S::or_>,
+      unary_kernel<Lanes, Lanes::negate, S::negate>,
+      unary_kernel<Lanes, Lanes::not_, S::not_>,
+  };
+  return &kernels;
+}
+} // namespace
+} // namespace GuiSE
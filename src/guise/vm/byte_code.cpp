@@ -1,5 +1,7 @@
 #include "byte_code.h"
 
+#include "heap.h"
+#include "object.h"
 #include "opcode.h"
 
 #include <guise/compiler/types.h>
@@ -8,30 +10,177 @@ using namespace GuiSE;
 
 void ByteCode::Write(uint8_t byte) { _byte_code.push_back(byte); }
 
-void ByteCode::AddFunction(const std::string &function_name, int fn_ptr) {
-  _functions.insert({function_name, fn_ptr});
+void ByteCode::Truncate(size_t length) { _byte_code.resize(length); }
+
+void ByteCode::Patch(size_t offset, uint8_t byte) {
+  _byte_code[offset] = byte;
+}
+
+int ByteCode::AddFunction(const std::string &function_name, size_t offset,
+                          const std::vector<ValueType> &params,
+                          ValueType return_type, bool memoized) {
+  const int index = _functions.size();
+  _functions.push_back({function_name, offset, offset,
+                        static_cast<uint8_t>(params.size()), 0, params,
+                        return_type, memoized});
+  _function_indices.insert({function_name, index});
+  return index;
+}
+
+int ByteCode::AddExternalFunction(const std::string &function_name,
+                                  const std::vector<ValueType> &params,
+                                  ValueType return_type, bool memoized) {
+  const int index =
+      AddFunction(function_name, 0, params, return_type, memoized);
+  _functions[index].external = true;
+  return index;
+}
+
+int ByteCode::FindFunction(const std::string &function_name) const {
+  auto it = _function_indices.find(function_name);
+  if (it != _function_indices.end()) {
+    return it->second;
+  }
+  return -1;
 }
 
 const uint8_t *ByteCode::GetFunction(const std::string &function_name) const {
-  auto it = _functions.find(function_name);
-  if (it != _functions.end()) {
-    return &_byte_code[it->second];
+  const int index = FindFunction(function_name);
+  if (index != -1) {
+    return (*this)[_functions[index].offset];
   }
   return nullptr;
 }
 
-int ByteCode::AddConstant(Value value) {
+const Function &ByteCode::GetFunctionInfo(int index) const {
+  return _functions[index];
+}
+
+size_t ByteCode::FunctionCount() const { return _functions.size(); }
+
+void ByteCode::SetMaxStack(int index, int max_stack) {
+  _functions[index].max_stack = max_stack;
+}
+
+void ByteCode::SetFunctionEnd(int index, size_t end) {
+  _functions[index].end = end;
+}
+
+int ByteCode::AddGlobal(const std::string &global_name, ValueType type,
+                        size_t offset) {
+  const int index = _globals.size();
+  _globals.push_back({global_name, type, offset, offset});
+  _global_indices[global_name] = index;
+  return index;
+}
+
+void ByteCode::SetGlobalOffset(int index, size_t offset) {
+  _globals[index].offset = offset;
+}
+
+void ByteCode::SetGlobalEnd(int index, size_t end) {
+  _globals[index].end = end;
+}
+
+int ByteCode::FindGlobal(const std::string &global_name) const {
+  auto it = _global_indices.find(global_name);
+  if (it != _global_indices.end()) {
+    return it->second;
+  }
+  return -1;
+}
+
+const Global &ByteCode::GetGlobalInfo(int index) const {
+  return _globals[index];
+}
+
+size_t ByteCode::GlobalCount() const { return _globals.size(); }
+
+void ByteCode::SetGlobalMaxStack(int max_stack) {
+  _global_max_stack = max_stack;
+}
+
+int ByteCode::GetGlobalMaxStack() const { return _global_max_stack; }
+
+void ByteCode::SetGlobalInit(size_t offset) { _global_init = offset; }
+
+size_t ByteCode::GetGlobalInit() const { return _global_init; }
+
+int ByteCode::AddConstant(Value value, ValueType type) {
   _constants.push_back(value);
+  _constant_types.push_back(type);
   return _constants.size() - 1;
 }
 
+Str *ByteCode::NewStr(const char *chars, size_t length) {
+  if (_heap == nullptr)
+    _heap = std::make_shared<Heap>();
+  return _heap->NewStr(chars, length);
+}
+
+const Heap *ByteCode::GetHeap() const { return _heap.get(); }
+
 Value ByteCode::GetConstant(int index) const { return _constants[index]; }
 
-size_t ByteCode::Length() const { return _byte_code.size(); }
+ValueType ByteCode::GetConstantType(int index) const {
+  return _constant_types[index];
+}
+
+size_t ByteCode::ConstantCount() const { return _constants.size(); }
+
+void ByteCode::TruncateConstants(size_t count) {
+  _constants.resize(count);
+  _constant_types.resize(count);
+}
+
+int ByteCode::AddFormat(FormatPlan plan) {
+  plan.max_length = plan.text.size();
+  for (const FormatSlot &slot : plan.slots) {
+    plan.max_length += format_bound(slot.type);
+  }
+  _formats.push_back(std::move(plan));
+  return _formats.size() - 1;
+}
+
+const FormatPlan &ByteCode::GetFormat(int index) const {
+  return _formats[index];
+}
+
+size_t ByteCode::FormatCount() const { return _formats.size(); }
+
+void ByteCode::TruncateFormats(size_t count) { _formats.resize(count); }
+
+void ByteCode::Relocate(std::vector<uint8_t> byte_code,
+                        const std::vector<size_t> &relocations) {
+  for (auto &function : _functions) {
+    function.offset = relocations[function.offset];
+    function.end = relocations[function.end];
+  }
+  for (auto &global : _globals) {
+    global.offset = relocations[global.offset];
+    global.end = relocations[global.end];
+  }
+  _global_init = relocations[_global_init];
+  _byte_code = std::move(byte_code);
+}
+
+void ByteCode::SetMappedCode(std::shared_ptr<const void> mapping,
+                             const uint8_t *code, size_t length) {
+  _byte_code.clear();
+  _mapping = std::move(mapping);
+  _mapped_code = code;
+  _mapped_length = length;
+}
+
+bool ByteCode::IsMapped() const { return _mapped_code != nullptr; }
+
+size_t ByteCode::Length() const {
+  return IsMapped() ? _mapped_length : _byte_code.size();
+}
 
 const uint8_t *ByteCode::operator[](const size_t i) const {
   if (i >= Length()) {
     return nullptr;
   }
-  return &_byte_code[i];
+  return IsMapped() ? _mapped_code + i : &_byte_code[i];
 }
@@ -1,21 +1,103 @@
 #pragma once
 
+#include "format.h"
+
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace GuiSE {
+class Heap;
+class Str;
 struct Value;
+enum class ValueType : uint8_t;
+
+struct Function {
+  std::string name;
+  size_t offset = 0;
+  size_t end = 0; // offset just past the function's code
+  uint8_t arity = 0;
+  int max_stack = 0; // deepest operand stack use relative to the frame
+  std::vector<ValueType> params;
+  ValueType return_type;
+  bool memoized = false; // results are cached by argument tuple
+  bool external = false; // defined in another unit and resolved by link
+};
+
+struct Global {
+  std::string name;
+  ValueType type;
+  size_t offset = 0; // initializer code
+  size_t end = 0;
+};
+
 class ByteCode {
 public:
   void Write(uint8_t byte);
+  void Truncate(size_t length);
+  void Patch(size_t offset, uint8_t byte);
 
-  void AddFunction(const std::string &function_name, int fn_ptr);
+  int AddFunction(const std::string &function_name, size_t offset,
+                  const std::vector<ValueType> &params, ValueType return_type,
+                  bool memoized);
+  // Declares a function a separately compiled unit calls but does not define.
+  int AddExternalFunction(const std::string &function_name,
+                          const std::vector<ValueType> &params,
+                          ValueType return_type, bool memoized);
+  int FindFunction(const std::string &function_name) const;
   const uint8_t *GetFunction(const std::string &function_name) const;
+  const Function &GetFunctionInfo(int index) const;
+  size_t FunctionCount() const;
+  void SetMaxStack(int index, int max_stack);
+  void SetFunctionEnd(int index, size_t end);
 
-  int AddConstant(Value value);
+  int AddGlobal(const std::string &global_name, ValueType type,
+                size_t offset);
+  void SetGlobalOffset(int index, size_t offset);
+  void SetGlobalEnd(int index, size_t end);
+  int FindGlobal(const std::string &global_name) const;
+  const Global &GetGlobalInfo(int index) const;
+  size_t GlobalCount() const;
+
+  void SetGlobalMaxStack(int max_stack);
+  int GetGlobalMaxStack() const;
+  // Offset of the block running every global initializer in slot order,
+  // after all function code and ended by NoOp.
+  void SetGlobalInit(size_t offset);
+  size_t GetGlobalInit() const;
+
+  int AddConstant(Value value, ValueType type);
+  // Returns the interned Str with these chars, which lives as long as this
+  // byte code or any copy of it, to be added as a constant.
+  Str *NewStr(const char *chars, size_t length);
+  // Holds the str constants, nullptr if there are none.
+  const Heap *GetHeap() const;
   Value GetConstant(int index) const;
+  ValueType GetConstantType(int index) const;
+  size_t ConstantCount() const;
+  // Drops the constants from count on, once no code refers to them.
+  void TruncateConstants(size_t count);
+
+  // Adds a format string for Format instructions, filling in its max_length.
+  int AddFormat(FormatPlan plan);
+  const FormatPlan &GetFormat(int index) const;
+  size_t FormatCount() const;
+  // Drops the format strings from count on, once no code refers to them.
+  void TruncateFormats(size_t count);
+
+  // Swaps in rewritten code. relocations maps each old instruction offset,
+  // and the old length, to its new offset so the function and global tables
+  // and the global initializer block follow.
+  void Relocate(std::vector<uint8_t> byte_code,
+                const std::vector<size_t> &relocations);
+
+  // Runs code from memory owned by mapping, such as a loaded image, instead of
+  // the written code. The code cannot be written or relocated afterwards.
+  void SetMappedCode(std::shared_ptr<const void> mapping, const uint8_t *code,
+                     size_t length);
+  bool IsMapped() const;
 
   const uint8_t *operator[](const size_t i) const;
 
@@ -24,6 +106,18 @@ public:
 private:
   std::vector<uint8_t> _byte_code;
   std::vector<Value> _constants;
-  std::map<std::string, int> _functions;
+  std::vector<ValueType> _constant_types;
+  // holds the str constants, shared by copies and kept alive by them
+  std::shared_ptr<Heap> _heap;
+  std::vector<FormatPlan> _formats;
+  std::vector<Function> _functions;
+  std::map<std::string, int> _function_indices;
+  std::vector<Global> _globals; // indexed by global slot
+  std::map<std::string, int> _global_indices;
+  int _global_max_stack = 0;
+  size_t _global_init = 0;
+  std::shared_ptr<const void> _mapping;
+  const uint8_t *_mapped_code = nullptr;
+  size_t _mapped_length = 0;
 };
 } // namespace GuiSE
\ No newline at end of file
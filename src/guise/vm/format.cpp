@@ -0,0 +1,105 @@
+#include "format.h"
+
+#include "object.h"
+
+#include <guise/compiler/types.h>
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+using namespace GuiSE;
+
+namespace {
+// "-1.23457e+308"
+constexpr size_t num_bound = 13;
+// "-128"
+constexpr size_t int_bound = 4;
+
+// Digits of a whole number below 10^6 in magnitude, which %g prints the same.
+size_t write_whole(long whole, char *out) {
+  char digits[8];
+  size_t count = 0;
+  const bool negative = whole < 0;
+  unsigned long magnitude = negative ? -whole : whole;
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+
+  size_t length = 0;
+  if (negative)
+    out[length++] = '-';
+  while (count > 0)
+    out[length++] = digits[--count];
+  return length;
+}
+} // namespace
+
+size_t GuiSE::format_bound(ValueType type) {
+  switch (type) {
+  case ValueType::Bool:
+    return 5;
+  case ValueType::Num:
+    return num_bound;
+  case ValueType::Int:
+    return int_bound;
+  default:
+    return 0;
+  }
+}
+
+size_t GuiSE::format_value(ValueType type, Value value, char *out) {
+  switch (type) {
+  case ValueType::Bool:
+    if (value.bool_) {
+      memcpy(out, "true", 4);
+      return 4;
+    }
+    memcpy(out, "false", 5);
+    return 5;
+  case ValueType::Num:
+    // labels mostly show whole numbers, written straight out; -0 keeps its sign
+    if (value.num == std::trunc(value.num) && std::fabs(value.num) < 1e6 &&
+        !(value.num == 0 && std::signbit(value.num)))
+      return write_whole(static_cast<long>(value.num), out);
+    // the same text as printf's %g, without parsing a format each time
+    return std::to_chars(out, out + num_bound, value.num,
+                         std::chars_format::general, 6)
+               .ptr -
+           out;
+  case ValueType::Int:
+    return write_whole(value.int_, out);
+  case ValueType::Str:
+    memcpy(out, value.str->get_chars(), value.str->get_length());
+    return value.str->get_length();
+  default:
+    return 0;
+  }
+}
+
+size_t GuiSE::format_bound(const FormatPlan &plan, const Value *args) {
+  size_t bound = plan.max_length;
+  for (size_t i = 0; i < plan.slots.size(); i++) {
+    if (plan.slots[i].type == ValueType::Str)
+      bound += args[i].str->get_length();
+  }
+  return bound;
+}
+
+size_t GuiSE::format(const FormatPlan &plan, const Value *args, char *out) {
+  const char *text = plan.text.data();
+  size_t length = 0;
+  size_t copied = 0;
+  for (size_t i = 0; i < plan.slots.size(); i++) {
+    const FormatSlot &slot = plan.slots[i];
+    memcpy(out + length, text + copied, slot.offset - copied);
+    length += slot.offset - copied;
+    copied = slot.offset;
+    length += format_value(slot.type, args[i], out + length);
+  }
+  memcpy(out + length, text + copied, plan.text.size() - copied);
+  length += plan.text.size() - copied;
+  out[length] = '\0';
+  return length;
+}
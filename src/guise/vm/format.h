@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GuiSE {
+struct Value;
+enum class ValueType : uint8_t;
+
+struct FormatSlot {
+  uint32_t offset; // in the text the value is written before
+  ValueType type;
+};
+
+// A compiled format string: literal text with a typed value written at each
+// slot, in slot order.
+struct FormatPlan {
+  std::string text;
+  std::vector<FormatSlot> slots;
+  // longest output, leaving out the length of str values
+  size_t max_length = 0;
+};
+
+// Longest text format_value writes for a value of type, 0 for str.
+size_t format_bound(ValueType type);
+
+// Writes value the way log_value prints it and returns the chars written.
+// out must have room for format_bound(type) chars, or the whole str.
+size_t format_value(ValueType type, Value value, char *out);
+
+// Longest output of plan with the slot values in args.
+size_t format_bound(const FormatPlan &plan, const Value *args);
+
+// Writes plan with the slot values in args to out, which must have room for
+// format_bound chars plus a terminator, and returns the chars written.
+size_t format(const FormatPlan &plan, const Value *args, char *out);
+} // namespace GuiSE
@@ -0,0 +1,294 @@
+#include "heap.h"
+
+#include "object.h"
+
+#include <guise/compiler/types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+using namespace GuiSE;
+
+namespace {
+constexpr size_t granule = alignof(Obj);
+// one bit per granule, at the start of every block
+constexpr size_t bitmap_size = HEAP_BLOCK_SIZE / granule / 8;
+
+size_t aligned(size_t size) { return (size + granule - 1) & ~(granule - 1); }
+
+size_t size_of(const Obj *obj) {
+  switch (obj->get_type()) {
+  case ObjType::Str:
+    return aligned(Str::Size(static_cast<const Str *>(obj)->get_length()));
+  }
+  return 0;
+}
+
+uint8_t *block_of(const void *pointer) {
+  return reinterpret_cast<uint8_t *>(reinterpret_cast<uintptr_t>(pointer) &
+                                     ~uintptr_t(HEAP_BLOCK_SIZE - 1));
+}
+
+// The bit in obj's block recording that an object starts at obj.
+void start_bit(const void *obj, uint8_t *&byte, uint8_t &mask) {
+  uint8_t *block = block_of(obj);
+  const size_t index = (static_cast<const uint8_t *>(obj) - block) / granule;
+  byte = block + index / 8;
+  mask = uint8_t(1) << (index % 8);
+}
+} // namespace
+
+// Walks the object list instead of recursing, so long lists cannot overflow
+// the stack. Only large objects are freed one by one.
+Heap::~Heap() {
+  for (Obj *obj = _objects; obj != nullptr;) {
+    Obj *next = obj->get_next();
+    if (size_of(obj) > HEAP_LARGE_SIZE)
+      ::operator delete(obj);
+    obj = next;
+  }
+  for (uint8_t *block : _blocks) {
+    ::operator delete(block, std::align_val_t(HEAP_BLOCK_SIZE));
+  }
+}
+
+Str *Heap::NewStr(const char *chars, size_t length) {
+  const uint32_t hash = Str::Hash(chars, length);
+  Str *str = _base != nullptr ? _base->FindStr(chars, length, hash) : nullptr;
+  if (str != nullptr)
+    return str;
+  str = FindStr(chars, length, hash);
+  if (str != nullptr) {
+    // a white str handed out mid-cycle would otherwise be swept while in use,
+    // just as a new one would be without starting black
+    if (_phase != GcPhase::Idle)
+      str->_marked = _black;
+    return str;
+  }
+
+  const size_t size = aligned(Str::Size(length));
+  str = Str::Place(_allocate(size), chars, length, hash);
+  _link(str, size);
+  _intern(str);
+  return str;
+}
+
+Str *Heap::FindStr(const char *chars, size_t length, uint32_t hash) const {
+  if (_strs.empty())
+    return nullptr;
+  const size_t mask = _strs.size() - 1;
+  for (size_t i = hash & mask; _strs[i] != nullptr; i = (i + 1) & mask) {
+    Str *str = _strs[i];
+    if (str->get_hash() == hash &&
+        static_cast<size_t>(str->get_length()) == length &&
+        memcmp(str->get_chars(), chars, length) == 0)
+      return str;
+  }
+  return nullptr;
+}
+
+bool Heap::Step(size_t budget, const RootMarker &mark_roots, bool force) {
+  if (_phase == GcPhase::Idle && !force && _bytes < _threshold) {
+    _debt = 0;
+    return false;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  if (_phase == GcPhase::Idle) {
+    _black = !_black;
+    _phase = GcPhase::Mark;
+    _stats.cycles++;
+    mark_roots(*this);
+  } else {
+    budget += std::min(_debt * GC_DEBT_RATIO, SIZE_MAX - budget);
+  }
+  _debt = 0;
+
+  for (size_t work = 0; work < budget && _phase != GcPhase::Idle;) {
+    if (_phase == GcPhase::Mark) {
+      if (_gray.empty()) {
+        mark_roots(*this);
+        if (_gray.empty()) {
+          _phase = GcPhase::Sweep;
+          _sweep = &_objects;
+        }
+        continue;
+      }
+      Obj *obj = _gray.back();
+      _gray.pop_back();
+      _blacken(obj);
+    } else {
+      Obj *obj = *_sweep;
+      if (obj == nullptr) {
+        _phase = GcPhase::Idle;
+        _threshold = std::max<size_t>(GC_INIT_THRESHOLD,
+                                      _bytes * GC_HEAP_GROWTH);
+        break;
+      }
+      if (obj->_marked == _black) {
+        _sweep = &obj->_next;
+      } else {
+        *_sweep = obj->_next;
+        _free(obj);
+      }
+    }
+    work++;
+  }
+
+  const double pause = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  _stats.steps++;
+  _stats.last_pause_ms = pause;
+  _stats.max_pause_ms = std::max(_stats.max_pause_ms, pause);
+  _stats.total_pause_ms += pause;
+  return _phase != GcPhase::Idle;
+}
+
+void Heap::Mark(Value value) {
+  Obj *obj = reinterpret_cast<Obj *>(value.str);
+  if (!Contains(obj) || obj->_marked == _black)
+    return;
+  obj->_marked = _black;
+  _gray.push_back(obj);
+}
+
+bool Heap::Contains(const void *pointer) const {
+  if (pointer == nullptr ||
+      reinterpret_cast<uintptr_t>(pointer) % granule != 0)
+    return false;
+  if (_block_addresses.count(
+          reinterpret_cast<uintptr_t>(block_of(pointer))) != 0) {
+    uint8_t *byte;
+    uint8_t mask;
+    start_bit(pointer, byte, mask);
+    return (*byte & mask) != 0;
+  }
+  return _large.count(static_cast<const Obj *>(pointer)) != 0;
+}
+
+void *Heap::_allocate(size_t size) {
+  if (size > HEAP_LARGE_SIZE)
+    return ::operator new(size);
+
+  const size_t size_class = size / granule;
+  FreeCell *cell =
+      size_class < _free_cells.size() ? _free_cells[size_class] : nullptr;
+  if (cell != nullptr) {
+    _free_cells[size_class] = cell->next;
+    return cell;
+  }
+
+  if (static_cast<size_t>(_limit - _top) < size) {
+    uint8_t *block = static_cast<uint8_t *>(
+        ::operator new(HEAP_BLOCK_SIZE, std::align_val_t(HEAP_BLOCK_SIZE)));
+    std::fill(block, block + bitmap_size, 0);
+    _blocks.push_back(block);
+    _block_addresses.insert(reinterpret_cast<uintptr_t>(block));
+    _top = block + bitmap_size;
+    _limit = block + HEAP_BLOCK_SIZE;
+  }
+  void *memory = _top;
+  _top += size;
+  return memory;
+}
+
+// New objects are black, so one made during a cycle survives it.
+void Heap::_link(Obj *obj, size_t size) {
+  if (size > HEAP_LARGE_SIZE) {
+    _large.insert(obj);
+  } else {
+    uint8_t *byte;
+    uint8_t mask;
+    start_bit(obj, byte, mask);
+    *byte |= mask;
+  }
+  obj->_marked = _black;
+  obj->_next = _objects;
+  _objects = obj;
+  _count++;
+  _bytes += size;
+  _debt++;
+}
+
+void Heap::_free(Obj *obj) {
+  if (obj->get_type() == ObjType::Str)
+    _unintern(static_cast<Str *>(obj));
+
+  const size_t size = size_of(obj);
+  _count--;
+  _bytes -= size;
+  _stats.freed_objects++;
+  _stats.freed_bytes += size;
+  if (size > HEAP_LARGE_SIZE) {
+    _large.erase(obj);
+    ::operator delete(obj);
+    return;
+  }
+
+  uint8_t *byte;
+  uint8_t mask;
+  start_bit(obj, byte, mask);
+  *byte &= ~mask;
+  const size_t size_class = size / granule;
+  if (size_class >= _free_cells.size())
+    _free_cells.resize(size_class + 1);
+  FreeCell *cell = reinterpret_cast<FreeCell *>(obj);
+  cell->next = _free_cells[size_class];
+  _free_cells[size_class] = cell;
+}
+
+// Marks everything obj refers to. No object type refers to others yet.
+void Heap::_blacken(Obj *obj) {
+  switch (obj->get_type()) {
+  case ObjType::Str:
+    break;
+  }
+}
+
+// Keeps the table at most half full.
+void Heap::_intern(Str *str) {
+  if ((_str_count + 1) * 2 > _strs.size()) {
+    std::vector<Str *> strs(std::max<size_t>(16, _strs.size() * 2));
+    const size_t mask = strs.size() - 1;
+    for (Str *old : _strs) {
+      if (old == nullptr)
+        continue;
+      size_t i = old->get_hash() & mask;
+      while (strs[i] != nullptr)
+        i = (i + 1) & mask;
+      strs[i] = old;
+    }
+    _strs = std::move(strs);
+  }
+
+  const size_t mask = _strs.size() - 1;
+  size_t i = str->get_hash() & mask;
+  while (_strs[i] != nullptr)
+    i = (i + 1) & mask;
+  _strs[i] = str;
+  _str_count++;
+}
+
+// Removes str and shifts back the entries probing past it, so lookups never
+// need tombstones.
+void Heap::_unintern(Str *str) {
+  const size_t mask = _strs.size() - 1;
+  size_t hole = str->get_hash() & mask;
+  while (_strs[hole] != str)
+    hole = (hole + 1) & mask;
+
+  for (size_t i = (hole + 1) & mask; _strs[i] != nullptr; i = (i + 1) & mask) {
+    // an entry may fill the hole unless its home slot lies after the hole
+    const size_t home = _strs[i]->get_hash() & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      _strs[hole] = _strs[i];
+      hole = i;
+    }
+  }
+  _strs[hole] = nullptr;
+  _str_count--;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+// bytes taken from the system at a time for small objects, and their
+// alignment
+#define HEAP_BLOCK_SIZE (64 * 1024)
+// objects larger than this get an allocation of their own
+#define HEAP_LARGE_SIZE 4096
+// objects marked or swept by one collection step unless told otherwise
+#define GC_STEP_WORK 1024
+// extra work a step does during a cycle for every object allocated since the
+// last step, so collection keeps pace with allocation
+#define GC_DEBT_RATIO 2
+// bytes held before the first collection cycle, and the least between cycles
+#define GC_INIT_THRESHOLD (1024 * 1024)
+// how far the heap may grow past what survived the last cycle before the
+// next one starts
+#define GC_HEAP_GROWTH 2
+
+namespace GuiSE {
+class Obj;
+class Str;
+struct Value;
+
+enum class GcPhase : uint8_t { Idle, Mark, Sweep };
+
+struct GcStats {
+  uint64_t cycles = 0;
+  uint64_t steps = 0;
+  uint64_t freed_objects = 0;
+  uint64_t freed_bytes = 0;
+  double last_pause_ms = 0;
+  double max_pause_ms = 0;
+  double total_pause_ms = 0;
+};
+
+// Allocator owning a set of objects. Small objects are carved from large
+// blocks, or reuse the memory of collected objects of the same size, so
+// allocating one rarely reaches malloc. Everything left is freed together
+// when the heap is destroyed. Not thread safe, though a base heap may be
+// shared by any number of heaps as long as nothing is allocated in it.
+class Heap {
+public:
+  using RootMarker = std::function<void(Heap &)>;
+
+  Heap() = default;
+  Heap(const Heap &) = delete;
+  Heap &operator=(const Heap &) = delete;
+  ~Heap();
+
+  // Returns the interned str with these chars, from the base heap if it has
+  // one, made here otherwise.
+  Str *NewStr(const char *chars, size_t length);
+  // The interned str with these chars, or nullptr.
+  Str *FindStr(const char *chars, size_t length, uint32_t hash) const;
+  // Strs already interned in base are shared instead of made again, so a
+  // str equal to a constant of the loaded code is that constant. base must
+  // outlive this heap's use of it.
+  inline void set_base(const Heap *base) { _base = base; }
+
+  // Does up to budget units of incremental tri-color mark and sweep work, an
+  // object blackened or swept each, so a cycle is spread over many short
+  // pauses. During a cycle the budget grows by GC_DEBT_RATIO units for each
+  // object allocated since the last step. A cycle starts once the heap has
+  // outgrown its threshold, or at once if force is set. mark_roots must Mark
+  // every root: it is called when a cycle starts and again whenever marking
+  // runs dry, since the roots may have changed between steps, and the sweep
+  // only starts once a rescan finds nothing new. Objects hold no references
+  // to each other, so that rescan is the only barrier marking needs. Returns
+  // whether a cycle is still in progress.
+  bool Step(size_t budget, const RootMarker &mark_roots, bool force = false);
+  // Marks the object value points to if it is one of this heap's. Any other
+  // bits are ignored, so words of unknown type can be passed.
+  void Mark(Value value);
+  bool Contains(const void *pointer) const;
+
+  // Every object in the heap, most recently allocated first.
+  inline Obj *get_objects() const { return _objects; }
+  inline size_t get_count() const { return _count; }
+  inline size_t get_bytes() const { return _bytes; }
+  inline GcPhase get_phase() const { return _phase; }
+  inline const GcStats &get_stats() const { return _stats; }
+
+private:
+  struct FreeCell {
+    FreeCell *next;
+  };
+
+  void *_allocate(size_t size);
+  void _link(Obj *obj, size_t size);
+  void _free(Obj *obj);
+  void _blacken(Obj *obj);
+  void _intern(Str *str);
+  void _unintern(Str *str);
+
+  Obj *_objects = nullptr;
+  size_t _count = 0;
+  size_t _bytes = 0; // held by objects, rounded up to their alignment
+  // each block starts with a bitmap of the granules objects start at
+  std::vector<uint8_t *> _blocks;
+  std::unordered_set<uintptr_t> _block_addresses;
+  std::unordered_set<const Obj *> _large;
+  std::vector<FreeCell *> _free_cells; // by size in granules
+  uint8_t *_top = nullptr; // free space left in the newest block
+  uint8_t *_limit = nullptr;
+  // open addressing with linear probing, the size a power of two
+  std::vector<Str *> _strs;
+  size_t _str_count = 0;
+  const Heap *_base = nullptr;
+
+  GcPhase _phase = GcPhase::Idle;
+  bool _black = false; // flipped every cycle, so survivors start white
+  std::vector<Obj *> _gray;
+  Obj **_sweep = nullptr; // link to the next object to sweep
+  size_t _threshold = GC_INIT_THRESHOLD;
+  size_t _debt = 0; // objects allocated since the last step
+  GcStats _stats;
+};
+} // namespace GuiSE
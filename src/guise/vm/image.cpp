@@ -0,0 +1,374 @@
+#include "image.h"
+
+#include "byte_code.h"
+#include "mapped_file.h"
+#include "object.h"
+
+#include <guise/compiler/types.h>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace GuiSE;
+
+namespace {
+constexpr char image_magic[4] = {'G', 'S', 'I', 'M'};
+constexpr uint32_t image_byte_order = 0x01020304;
+
+struct Section {
+  uint32_t offset; // from the start of the image
+  uint32_t count;  // bytes for code and strings, entries for the tables
+};
+
+struct ImageHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t byte_order;
+  int32_t global_max_stack;
+  uint64_t source_hash;
+  Section code;
+  Section constants;
+  Section functions;
+  Section globals;
+  Section formats;
+  Section format_slots;
+  Section strings;
+  uint32_t global_init; // offset of the global initializers in the code
+  uint32_t source_path; // in the strings section
+  uint32_t source_path_length;
+  uint32_t padding;
+};
+
+// Strings, names and parameter types are stored as ranges of the strings
+// section.
+struct ImageConstant {
+  uint64_t bits; // the value, or the string's offset for str
+  uint32_t length;
+  uint8_t type;
+  uint8_t padding[3];
+};
+
+struct ImageFunction {
+  uint32_t name;
+  uint32_t name_length;
+  uint32_t offset;
+  uint32_t end;
+  uint32_t params;
+  int32_t max_stack;
+  uint8_t arity;
+  uint8_t return_type;
+  uint8_t memoized;
+  uint8_t external;
+};
+
+struct ImageGlobal {
+  uint32_t name;
+  uint32_t name_length;
+  uint32_t offset;
+  uint32_t end;
+  uint8_t type;
+  uint8_t padding[3];
+};
+
+// A format's slots are a range of the format slots section.
+struct ImageFormat {
+  uint32_t text;
+  uint32_t text_length;
+  uint32_t slots;
+  uint32_t slot_count;
+};
+
+struct ImageFormatSlot {
+  uint32_t offset;
+  uint8_t type;
+  uint8_t padding[3];
+};
+
+static_assert(std::is_trivially_copyable<Value>::value &&
+                  sizeof(Value) == sizeof(uint64_t),
+              "constants are stored as 64-bit words");
+
+uint32_t align(size_t offset) { return (offset + 7) & ~size_t(7); }
+
+class Writer {
+public:
+  uint32_t String(const char *chars, size_t length) {
+    const uint32_t offset = _strings.size();
+    _strings.insert(_strings.end(), chars, chars + length);
+    return offset;
+  }
+
+  // Places a section of entries at offset and moves offset past it.
+  template <typename T>
+  void Place(Section &section, const std::vector<T> &entries,
+             uint32_t &offset) {
+    section = {offset, static_cast<uint32_t>(entries.size())};
+    offset = align(offset + entries.size() * sizeof(T));
+  }
+
+  std::vector<char> &get_strings() { return _strings; }
+
+private:
+  std::vector<char> _strings;
+};
+
+template <typename T>
+void write_section(std::ostream &out, const std::vector<T> &entries) {
+  const size_t size = entries.size() * sizeof(T);
+  out.write(reinterpret_cast<const char *>(entries.data()), size);
+  static const char padding[8] = {};
+  out.write(padding, align(size) - size);
+}
+
+bool in_bounds(const Section &section, size_t entry_size, size_t size) {
+  return section.offset <= size &&
+         section.count <= (size - section.offset) / entry_size;
+}
+
+bool in_strings(const ImageHeader &header, uint32_t offset, uint32_t length) {
+  return offset <= header.strings.count &&
+         length <= header.strings.count - offset;
+}
+} // namespace
+
+uint64_t GuiSE::source_hash(const char *source, size_t length) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ static_cast<uint8_t>(source[i])) * 1099511628211ull;
+  }
+  return hash;
+}
+
+bool GuiSE::write_image(const ByteCode &byte_code, uint64_t hash,
+                        std::ostream &out, const std::string &source_path) {
+  Writer writer;
+
+  std::vector<ImageConstant> constants(byte_code.ConstantCount());
+  for (size_t i = 0; i < constants.size(); i++) {
+    const Value value = byte_code.GetConstant(i);
+    const ValueType type = byte_code.GetConstantType(i);
+    ImageConstant &constant = constants[i];
+    constant.type = static_cast<uint8_t>(type);
+    if (type == ValueType::Str) {
+      constant.bits =
+          writer.String(value.str->get_chars(), value.str->get_length());
+      constant.length = value.str->get_length();
+    } else {
+      memcpy(&constant.bits, &value, sizeof(constant.bits));
+    }
+  }
+
+  std::vector<ImageFunction> functions(byte_code.FunctionCount());
+  for (size_t i = 0; i < functions.size(); i++) {
+    const Function &function = byte_code.GetFunctionInfo(i);
+    ImageFunction &entry = functions[i];
+    entry.name = writer.String(function.name.data(), function.name.size());
+    entry.name_length = function.name.size();
+    entry.offset = function.offset;
+    entry.end = function.end;
+    entry.params =
+        writer.String(reinterpret_cast<const char *>(function.params.data()),
+                      function.params.size());
+    entry.max_stack = function.max_stack;
+    entry.arity = function.arity;
+    entry.return_type = static_cast<uint8_t>(function.return_type);
+    entry.memoized = function.memoized;
+    entry.external = function.external;
+  }
+
+  std::vector<ImageGlobal> globals(byte_code.GlobalCount());
+  for (size_t i = 0; i < globals.size(); i++) {
+    const Global &global = byte_code.GetGlobalInfo(i);
+    ImageGlobal &entry = globals[i];
+    entry.name = writer.String(global.name.data(), global.name.size());
+    entry.name_length = global.name.size();
+    entry.offset = global.offset;
+    entry.end = global.end;
+    entry.type = static_cast<uint8_t>(global.type);
+  }
+
+  std::vector<ImageFormat> formats(byte_code.FormatCount());
+  std::vector<ImageFormatSlot> format_slots;
+  for (size_t i = 0; i < formats.size(); i++) {
+    const FormatPlan &plan = byte_code.GetFormat(i);
+    ImageFormat &entry = formats[i];
+    entry.text = writer.String(plan.text.data(), plan.text.size());
+    entry.text_length = plan.text.size();
+    entry.slots = format_slots.size();
+    entry.slot_count = plan.slots.size();
+    for (const FormatSlot &slot : plan.slots) {
+      format_slots.push_back(
+          {slot.offset, static_cast<uint8_t>(slot.type), {}});
+    }
+  }
+
+  const uint8_t *code = byte_code[0];
+  const std::vector<uint8_t> code_bytes(code, code + byte_code.Length());
+
+  ImageHeader header = {};
+  memcpy(header.magic, image_magic, sizeof(image_magic));
+  header.version = IMAGE_VERSION;
+  header.byte_order = image_byte_order;
+  header.global_max_stack = byte_code.GetGlobalMaxStack();
+  header.global_init = byte_code.GetGlobalInit();
+  header.source_hash = hash;
+  header.source_path = writer.String(source_path.data(), source_path.size());
+  header.source_path_length = source_path.size();
+
+  uint32_t offset = align(sizeof(ImageHeader));
+  writer.Place(header.code, code_bytes, offset);
+  writer.Place(header.constants, constants, offset);
+  writer.Place(header.functions, functions, offset);
+  writer.Place(header.globals, globals, offset);
+  writer.Place(header.formats, formats, offset);
+  writer.Place(header.format_slots, format_slots, offset);
+  writer.Place(header.strings, writer.get_strings(), offset);
+
+  write_section(out, std::vector<ImageHeader>{header});
+  write_section(out, code_bytes);
+  write_section(out, constants);
+  write_section(out, functions);
+  write_section(out, globals);
+  write_section(out, formats);
+  write_section(out, format_slots);
+  write_section(out, writer.get_strings());
+  return static_cast<bool>(out);
+}
+
+bool GuiSE::is_image(const char *file_name) {
+  std::ifstream file(file_name, std::ios::binary);
+  char magic[sizeof(image_magic)];
+  return file.read(magic, sizeof(magic)) &&
+         memcmp(magic, image_magic, sizeof(magic)) == 0;
+}
+
+bool GuiSE::load_image(const char *file_name, ByteCode &byte_code,
+                       uint64_t *hash, std::string *source_path) {
+  size_t size = 0;
+  std::shared_ptr<const void> mapping = map_file(file_name, size);
+  if (mapping == nullptr || size < sizeof(ImageHeader)) {
+    return false;
+  }
+
+  const uint8_t *data = static_cast<const uint8_t *>(mapping.get());
+  const ImageHeader &header = *reinterpret_cast<const ImageHeader *>(data);
+  if (memcmp(header.magic, image_magic, sizeof(image_magic)) != 0 ||
+      header.version != IMAGE_VERSION ||
+      header.byte_order != image_byte_order ||
+      !in_bounds(header.code, 1, size) ||
+      !in_bounds(header.constants, sizeof(ImageConstant), size) ||
+      !in_bounds(header.functions, sizeof(ImageFunction), size) ||
+      !in_bounds(header.globals, sizeof(ImageGlobal), size) ||
+      !in_bounds(header.formats, sizeof(ImageFormat), size) ||
+      !in_bounds(header.format_slots, sizeof(ImageFormatSlot), size) ||
+      !in_bounds(header.strings, 1, size) ||
+      header.global_init >= header.code.count ||
+      !in_strings(header, header.source_path, header.source_path_length)) {
+    return false;
+  }
+
+  const char *strings =
+      reinterpret_cast<const char *>(data + header.strings.offset);
+  const uint32_t code_length = header.code.count;
+  ByteCode loaded;
+
+  const ImageConstant *constants =
+      reinterpret_cast<const ImageConstant *>(data + header.constants.offset);
+  for (uint32_t i = 0; i < header.constants.count; i++) {
+    const ImageConstant &constant = constants[i];
+    const ValueType type = static_cast<ValueType>(constant.type);
+    Value value;
+    if (type == ValueType::Str) {
+      if (!in_strings(header, constant.bits, constant.length)) {
+        return false;
+      }
+      value = loaded.NewStr(strings + constant.bits, constant.length);
+    } else {
+      memcpy(&value, &constant.bits, sizeof(value));
+    }
+    loaded.AddConstant(value, type);
+  }
+
+  const ImageFunction *functions =
+      reinterpret_cast<const ImageFunction *>(data + header.functions.offset);
+  for (uint32_t i = 0; i < header.functions.count; i++) {
+    const ImageFunction &function = functions[i];
+    if (!in_strings(header, function.name, function.name_length) ||
+        !in_strings(header, function.params, function.arity) ||
+        function.offset >= code_length || function.end > code_length) {
+      return false;
+    }
+    const ValueType *params =
+        reinterpret_cast<const ValueType *>(strings + function.params);
+    const std::string name(strings + function.name, function.name_length);
+    const std::vector<ValueType> param_types(params, params + function.arity);
+    const ValueType return_type = static_cast<ValueType>(function.return_type);
+    if (function.external) {
+      loaded.AddExternalFunction(name, param_types, return_type,
+                                 function.memoized);
+      continue;
+    }
+    const int index = loaded.AddFunction(name, function.offset, param_types,
+                                         return_type, function.memoized);
+    loaded.SetMaxStack(index, function.max_stack);
+    loaded.SetFunctionEnd(index, function.end);
+  }
+
+  const ImageGlobal *globals =
+      reinterpret_cast<const ImageGlobal *>(data + header.globals.offset);
+  for (uint32_t i = 0; i < header.globals.count; i++) {
+    const ImageGlobal &global = globals[i];
+    if (!in_strings(header, global.name, global.name_length) ||
+        global.offset > code_length || global.end > code_length) {
+      return false;
+    }
+    const int index = loaded.AddGlobal(
+        std::string(strings + global.name, global.name_length),
+        static_cast<ValueType>(global.type), global.offset);
+    loaded.SetGlobalEnd(index, global.end);
+  }
+
+  const ImageFormat *formats =
+      reinterpret_cast<const ImageFormat *>(data + header.formats.offset);
+  const ImageFormatSlot *format_slots =
+      reinterpret_cast<const ImageFormatSlot *>(data +
+                                                header.format_slots.offset);
+  for (uint32_t i = 0; i < header.formats.count; i++) {
+    const ImageFormat &format = formats[i];
+    if (!in_strings(header, format.text, format.text_length) ||
+        format.slots > header.format_slots.count ||
+        format.slot_count > header.format_slots.count - format.slots) {
+      return false;
+    }
+    FormatPlan plan;
+    plan.text.assign(strings + format.text, format.text_length);
+    uint32_t text_offset = 0;
+    for (uint32_t j = 0; j < format.slot_count; j++) {
+      // slots go in text order
+      const ImageFormatSlot &slot = format_slots[format.slots + j];
+      if (slot.offset < text_offset || slot.offset > format.text_length) {
+        return false;
+      }
+      text_offset = slot.offset;
+      plan.slots.push_back({slot.offset, static_cast<ValueType>(slot.type)});
+    }
+    loaded.AddFormat(std::move(plan));
+  }
+
+  loaded.SetGlobalMaxStack(header.global_max_stack);
+  loaded.SetGlobalInit(header.global_init);
+  loaded.SetMappedCode(std::move(mapping), data + header.code.offset,
+                       code_length);
+  if (hash != nullptr) {
+    *hash = header.source_hash;
+  }
+  if (source_path != nullptr) {
+    source_path->assign(strings + header.source_path,
+                        header.source_path_length);
+  }
+  byte_code = std::move(loaded);
+  return true;
+}
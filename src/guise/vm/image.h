@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace GuiSE {
+class ByteCode;
+
+// Bumped whenever the image layout or the instruction encoding changes.
+constexpr uint32_t IMAGE_VERSION = 5;
+
+// FNV-1a hash of a script's source.
+uint64_t source_hash(const char *source, size_t length);
+
+// Writes byte_code as a binary image. Every section is addressed by offset
+// from the start of the image, so it can be mapped anywhere. Images use the
+// writer's byte order and are rejected on hosts with a different one. hash
+// identifies the sources the code was built from, and source_path, if not
+// empty, where to find them to check it.
+bool write_image(const ByteCode &byte_code, uint64_t hash, std::ostream &out,
+                 const std::string &source_path = std::string());
+
+// Returns true if file_name starts with the image magic.
+bool is_image(const char *file_name);
+
+// Maps an image into memory and points byte_code at its code, which the VM
+// then runs in place. Only the constant, function, global and format tables
+// are rebuilt. The mapping lives as long as byte_code. If hash or source_path
+// are not null they receive those the image was written with.
+bool load_image(const char *file_name, ByteCode &byte_code,
+                uint64_t *hash = nullptr, std::string *source_path = nullptr);
+} // namespace GuiSE
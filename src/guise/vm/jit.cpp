@@ -0,0 +1,463 @@
+#include "jit.h"
+
+#include "byte_code.h"
+#include "opcode.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+
+#ifdef GUISE_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace GuiSE;
+
+#ifdef GUISE_JIT
+namespace {
+enum class Condition : uint8_t {
+  Equal = 0x94,
+  NotEqual = 0x95,
+  BelowEqual = 0x96,
+  Above = 0x97,
+  Parity = 0x9a,
+  NoParity = 0x9b,
+};
+
+enum class SseOp : uint8_t {
+  Add = 0x58,
+  Multiply = 0x59,
+  Subtract = 0x5c,
+  Divide = 0x5e,
+};
+
+// Deepest chain of native calls allowed, so compiled code can't exhaust the
+// machine stack where the interpreter would have grown its own.
+constexpr int max_native_nesting = 4096;
+
+// Reg fields of the few registers the templates use.
+constexpr uint8_t rax = 0;
+constexpr uint8_t rcx = 1;
+constexpr uint8_t rdi = 7;
+
+uint64_t bits_of(Value value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// Emits the x86-64 instructions used by the templates. The frame pointer is
+// kept in rbx, so every stack slot is addressed as [rbx + 8 * slot]; xmm0,
+// xmm1, rax and rcx are scratch.
+class Assembler {
+public:
+  inline size_t Length() const { return _code.size(); }
+  inline const std::vector<uint8_t> &get_code() const { return _code; }
+  void Truncate(size_t length) { _code.resize(length); }
+
+  // push rbx; mov rbx, rdi
+  void Prologue() { _emit({0x53, 0x48, 0x89, 0xfb}); }
+  // pop rbx; ret
+  void Epilogue() { _emit({0x5b, 0xc3}); }
+
+  // mov rax, [slot]
+  void Load(int slot) { _slot_op({0x48, 0x8b}, rax, slot); }
+  // mov [slot], rax
+  void Store(int slot) { _slot_op({0x48, 0x89}, rax, slot); }
+  // mov rax, imm64
+  void LoadImmediate(uint64_t bits) {
+    _emit({0x48, 0xb8});
+    _emit_bytes(&bits, sizeof(bits));
+  }
+  // mov qword [slot], imm32
+  void StoreImmediate(int slot, int32_t value) {
+    _slot_op({0x48, 0xc7}, 0, slot);
+    _emit_bytes(&value, sizeof(value));
+  }
+
+  // movsd xmm0, [slot]
+  void LoadNum(int slot) { _slot_op({0xf2, 0x0f, 0x10}, 0, slot); }
+  // movsd [slot], xmm0
+  void StoreNum(int slot) { _slot_op({0xf2, 0x0f, 0x11}, 0, slot); }
+  // <op>sd xmm0, [slot]
+  void Arithmetic(SseOp op, int slot) {
+    _slot_op({0xf2, 0x0f, static_cast<uint8_t>(op)}, 0, slot);
+  }
+  // movq xmm1, rax; <op>sd xmm0, xmm1
+  void ArithmeticRax(SseOp op) {
+    _emit({0x66, 0x48, 0x0f, 0x6e, 0xc8});
+    _emit({0xf2, 0x0f, static_cast<uint8_t>(op), 0xc1});
+  }
+  // ucomisd xmm0, [slot]
+  void CompareNum(int slot) { _slot_op({0x66, 0x0f, 0x2e}, 0, slot); }
+  // btc rax, 63
+  void FlipSign() { _emit({0x48, 0x0f, 0xba, 0xf8, 0x3f}); }
+
+  // set<cc> al or cl
+  void SetCondition(Condition condition, uint8_t reg) {
+    _emit({0x0f, static_cast<uint8_t>(condition),
+           static_cast<uint8_t>(0xc0 | reg)});
+  }
+  // and al, cl
+  void AndCl() { _emit({0x20, 0xc8}); }
+  // or al, cl
+  void OrCl() { _emit({0x08, 0xc8}); }
+  // mov al, [slot]
+  void LoadBool(int slot) { _slot_op({0x8a}, rax, slot); }
+  // and al, [slot]
+  void AndBool(int slot) { _slot_op({0x22}, rax, slot); }
+  // or al, [slot]
+  void OrBool(int slot) { _slot_op({0x0a}, rax, slot); }
+  // cmp byte [slot], 0
+  void TestBool(int slot) {
+    _slot_op({0x80}, 7, slot);
+    _emit({0x00});
+  }
+  // movzx eax, al; mov [slot], rax
+  void StoreBool(int slot) {
+    _emit({0x0f, 0xb6, 0xc0});
+    Store(slot);
+  }
+
+  // lea rdi, [slot]
+  void LoadFrame(int slot) { _slot_op({0x48, 0x8d}, rdi, slot); }
+  // mov rdi, rbx
+  void PassFrame() { _emit({0x48, 0x89, 0xdf}); }
+  // call rel32
+  void Call(size_t target) { _branch(0xe8, target); }
+  // pop rbx; jmp rel32
+  void TailJump(size_t target) {
+    _emit({0x5b});
+    _branch(0xe9, target);
+  }
+
+private:
+  void _emit(std::initializer_list<uint8_t> bytes) {
+    _code.insert(_code.end(), bytes);
+  }
+
+  void _emit_bytes(const void *bytes, size_t length) {
+    const uint8_t *begin = static_cast<const uint8_t *>(bytes);
+    _code.insert(_code.end(), begin, begin + length);
+  }
+
+  // opcode bytes followed by a ModRM for [rbx + disp32]
+  void _slot_op(std::initializer_list<uint8_t> op, uint8_t reg, int slot) {
+    _emit(op);
+    _emit({static_cast<uint8_t>(0x80 | reg << 3 | 3)});
+    const int32_t disp = slot * static_cast<int32_t>(sizeof(Value));
+    _emit_bytes(&disp, sizeof(disp));
+  }
+
+  void _branch(uint8_t op, size_t target) {
+    _emit({op});
+    const int32_t rel = static_cast<int32_t>(target - (Length() + 4));
+    _emit_bytes(&rel, sizeof(rel));
+  }
+
+  std::vector<uint8_t> _code;
+};
+
+// Sets al to slot a <cc> slot b.
+void compare(Assembler &assembler, int a, int b, Condition condition) {
+  assembler.LoadNum(a);
+  assembler.CompareNum(b);
+  assembler.SetCondition(condition, rax);
+}
+
+bool arithmetic_op(OpCode op_code, SseOp &op) {
+  switch (op_code) {
+  case OpCode::Add:
+  case OpCode::AddLocalLocal:
+  case OpCode::AddLocalConst:
+  case OpCode::AddLocalImm:
+    op = SseOp::Add;
+    return true;
+  case OpCode::Subtract:
+  case OpCode::SubtractLocalLocal:
+  case OpCode::SubtractLocalConst:
+  case OpCode::SubtractLocalImm:
+    op = SseOp::Subtract;
+    return true;
+  case OpCode::Multiply:
+  case OpCode::MultiplyLocalLocal:
+  case OpCode::MultiplyLocalConst:
+  case OpCode::MultiplyLocalImm:
+    op = SseOp::Multiply;
+    return true;
+  case OpCode::Divide:
+  case OpCode::DivideLocalLocal:
+  case OpCode::DivideLocalConst:
+  case OpCode::DivideLocalImm:
+    op = SseOp::Divide;
+    return true;
+  default:
+    return false;
+  }
+}
+
+struct Translation {
+  ptrdiff_t entry = -1; // code offset, -1 if not compiled
+  int stack = 0;
+  int nesting = 1; // native frames on the deepest call chain
+};
+
+// Translates one function, tracking the operand stack depth statically so each
+// push and pop becomes a fixed frame slot. Returns false on the first
+// instruction without a template.
+bool translate(Assembler &assembler, const ByteCode &byte_code, int index,
+               std::vector<Translation> &translations) {
+  const Function &function = byte_code.GetFunctionInfo(index);
+  int depth = function.arity;
+  int stack = function.max_stack;
+  int nesting = 1;
+
+  assembler.Prologue();
+  for (size_t offset = function.offset; offset < function.end;) {
+    const uint8_t *ip = byte_code[offset];
+    offset += instruction_length(ip);
+
+    OpCode op_code = static_cast<OpCode>(ip[0]);
+    int operand = op_info(op_code).operand_bytes > 0 ? ip[1] : 0;
+    if (op_code == OpCode::Wide) {
+      op_code = static_cast<OpCode>(ip[1]);
+      operand = ip[2] | ip[3] << 8;
+      if (op_code != OpCode::Constant && op_code != OpCode::GetLocal &&
+          op_code != OpCode::SetLocal)
+        return false;
+    }
+
+    SseOp op;
+    switch (op_code) {
+    case OpCode::Constant:
+      assembler.LoadImmediate(bits_of(byte_code.GetConstant(operand)));
+      assembler.Store(depth++);
+      break;
+    case OpCode::GetLocal:
+      assembler.Load(operand);
+      assembler.Store(depth++);
+      break;
+    case OpCode::SetLocal:
+      assembler.Load(depth - 1);
+      assembler.Store(operand);
+      break;
+    case OpCode::PushZero:
+      assembler.StoreImmediate(depth++, 0);
+      break;
+    case OpCode::PushSmallNum:
+      assembler.LoadImmediate(
+          bits_of(static_cast<Num>(static_cast<int8_t>(operand))));
+      assembler.Store(depth++);
+      break;
+    case OpCode::True:
+      assembler.StoreImmediate(depth++, 1);
+      break;
+    case OpCode::False:
+      assembler.StoreImmediate(depth++, 0);
+      break;
+    case OpCode::StackUp:
+      depth++;
+      break;
+    case OpCode::Pop:
+      depth--;
+      break;
+    case OpCode::Add:
+    case OpCode::Subtract:
+    case OpCode::Multiply:
+    case OpCode::Divide:
+      arithmetic_op(op_code, op);
+      assembler.LoadNum(depth - 2);
+      assembler.Arithmetic(op, depth - 1);
+      assembler.StoreNum(depth - 2);
+      depth--;
+      break;
+    case OpCode::AddLocalLocal:
+    case OpCode::SubtractLocalLocal:
+    case OpCode::MultiplyLocalLocal:
+    case OpCode::DivideLocalLocal:
+      arithmetic_op(op_code, op);
+      assembler.LoadNum(ip[1]);
+      assembler.Arithmetic(op, ip[2]);
+      assembler.StoreNum(depth++);
+      break;
+    case OpCode::AddLocalConst:
+    case OpCode::SubtractLocalConst:
+    case OpCode::MultiplyLocalConst:
+    case OpCode::DivideLocalConst:
+      arithmetic_op(op_code, op);
+      assembler.LoadNum(ip[1]);
+      assembler.LoadImmediate(bits_of(byte_code.GetConstant(ip[2])));
+      assembler.ArithmeticRax(op);
+      assembler.StoreNum(depth++);
+      break;
+    case OpCode::AddLocalImm:
+    case OpCode::SubtractLocalImm:
+    case OpCode::MultiplyLocalImm:
+    case OpCode::DivideLocalImm:
+      arithmetic_op(op_code, op);
+      assembler.LoadNum(ip[1]);
+      assembler.LoadImmediate(
+          bits_of(static_cast<Num>(static_cast<int8_t>(ip[2]))));
+      assembler.ArithmeticRax(op);
+      assembler.StoreNum(depth++);
+      break;
+    case OpCode::Negate:
+      assembler.Load(depth - 1);
+      assembler.FlipSign();
+      assembler.Store(depth - 1);
+      break;
+    case OpCode::Not:
+      assembler.TestBool(depth - 1);
+      assembler.SetCondition(Condition::Equal, rax);
+      assembler.StoreBool(depth - 1);
+      break;
+    // comparisons match the interpreter's NaN behaviour: unordered operands
+    // set ZF, PF and CF
+    case OpCode::Equal:
+    case OpCode::NotEqual:
+      compare(assembler, depth - 2, depth - 1,
+              op_code == OpCode::Equal ? Condition::Equal
+                                       : Condition::NotEqual);
+      if (op_code == OpCode::Equal) {
+        assembler.SetCondition(Condition::NoParity, rcx);
+        assembler.AndCl();
+      } else {
+        assembler.SetCondition(Condition::Parity, rcx);
+        assembler.OrCl();
+      }
+      assembler.StoreBool(depth - 2);
+      depth--;
+      break;
+    case OpCode::Greater:
+      compare(assembler, depth - 2, depth - 1, Condition::Above);
+      assembler.StoreBool(depth - 2);
+      depth--;
+      break;
+    case OpCode::Less:
+      compare(assembler, depth - 1, depth - 2, Condition::Above);
+      assembler.StoreBool(depth - 2);
+      depth--;
+      break;
+    case OpCode::GreaterEqual: // !(a < b)
+      compare(assembler, depth - 1, depth - 2, Condition::BelowEqual);
+      assembler.StoreBool(depth - 2);
+      depth--;
+      break;
+    case OpCode::LessEqual: // !(a > b)
+      compare(assembler, depth - 2, depth - 1, Condition::BelowEqual);
+      assembler.StoreBool(depth - 2);
+      depth--;
+      break;
+    case OpCode::And:
+    case OpCode::Or:
+      assembler.LoadBool(depth - 2);
+      if (op_code == OpCode::And) {
+        assembler.AndBool(depth - 1);
+      } else {
+        assembler.OrBool(depth - 1);
+      }
+      assembler.StoreBool(depth - 2);
+      depth--;
+      break;
+    case OpCode::CallDirect:
+    case OpCode::TailCall: {
+      const Translation &callee = translations[ip[1] | ip[2] << 8];
+      const int arg_count = ip[3];
+      if (callee.entry == -1 || callee.nesting >= max_native_nesting)
+        return false;
+
+      const int base = depth - arg_count;
+      if (op_code == OpCode::CallDirect) {
+        assembler.LoadFrame(base);
+        assembler.Call(callee.entry);
+        stack = std::max(stack, base + callee.stack);
+        nesting = std::max(nesting, callee.nesting + 1);
+      } else {
+        // move the arguments down to fp and let the callee return for us
+        for (int i = 0; i < arg_count; i++) {
+          assembler.Load(base + i);
+          assembler.Store(i);
+        }
+        assembler.PassFrame();
+        assembler.TailJump(callee.entry);
+        stack = std::max(stack, callee.stack);
+        nesting = std::max(nesting, callee.nesting);
+      }
+      depth = base;
+    } break;
+    case OpCode::Return:
+      assembler.Load(depth - 1);
+      assembler.Store(-1);
+      assembler.Epilogue();
+      depth--;
+      break;
+    default:
+      return false;
+    }
+  }
+
+  translations[index].stack = stack;
+  translations[index].nesting = nesting;
+  return true;
+}
+} // namespace
+
+Jit::~Jit() {
+  if (_code != nullptr)
+    munmap(_code, _size);
+}
+
+std::vector<NativeFunction> Jit::Compile(const ByteCode &byte_code) {
+  const size_t count = byte_code.FunctionCount();
+  std::vector<NativeFunction> functions(count);
+  std::vector<Translation> translations(count);
+
+  // functions only call earlier ones, so a single pass resolves every call
+  Assembler assembler;
+  for (size_t i = 0; i < count; i++) {
+    const size_t start = assembler.Length();
+    if (translate(assembler, byte_code, i, translations)) {
+      translations[i].entry = start;
+    } else {
+      assembler.Truncate(start);
+    }
+  }
+
+  if (_code != nullptr) {
+    munmap(_code, _size);
+    _code = nullptr;
+  }
+  if (assembler.Length() == 0)
+    return functions;
+
+  // written while writable, then flipped to executable
+  const size_t page = sysconf(_SC_PAGESIZE);
+  const size_t size = (assembler.Length() + page - 1) / page * page;
+  void *code = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED)
+    return functions;
+  memcpy(code, assembler.get_code().data(), assembler.Length());
+  if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(code, size);
+    return functions;
+  }
+  _code = code;
+  _size = size;
+
+  for (size_t i = 0; i < count; i++) {
+    const Translation &translation = translations[i];
+    if (translation.entry == -1)
+      continue;
+    functions[i].entry = reinterpret_cast<NativeFn>(
+        static_cast<uint8_t *>(code) + translation.entry);
+    functions[i].stack = translation.stack;
+  }
+  return functions;
+}
+#else
+Jit::~Jit() {}
+
+std::vector<NativeFunction> Jit::Compile(const ByteCode &) { return {}; }
+#endif
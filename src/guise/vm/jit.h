@@ -0,0 +1,39 @@
+#pragma once
+
+#include <guise/compiler/types.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace GuiSE {
+class ByteCode;
+
+// Native code for one function. It takes the same frame as the interpreter,
+// arguments from fp[0] on, and stores its result in fp[-1].
+using NativeFn = void (*)(Value *fp);
+
+struct NativeFunction {
+  NativeFn entry = nullptr;
+  int stack = 0; // stack slots used from fp, including any native callees
+};
+
+// Template JIT translating num/bool functions to x86-64. Only functions made
+// entirely of local, constant, arithmetic, comparison and call instructions
+// are compiled, and they may only call functions that were compiled before
+// them; everything else keeps running in the interpreter.
+class Jit {
+public:
+  Jit() = default;
+  Jit(const Jit &) = delete;
+  Jit &operator=(const Jit &) = delete;
+  ~Jit();
+
+  // Returns one entry per function, with a null entry for functions that
+  // could not be compiled. Always empty when built without GUISE_JIT.
+  std::vector<NativeFunction> Compile(const ByteCode &byte_code);
+
+private:
+  void *_code = nullptr;
+  size_t _size = 0;
+};
+} // namespace GuiSE
@@ -0,0 +1,64 @@
+#include "mapped_file.h"
+
+#include <cstdint>
+
+#ifdef _WIN32
+#include <cstdio>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace GuiSE;
+
+std::shared_ptr<const void> GuiSE::map_file(const char *file_name,
+                                            size_t &size) {
+#ifdef _WIN32
+  FILE *file = fopen(file_name, "rb");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  fseek(file, 0, SEEK_END);
+  const long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  std::shared_ptr<uint8_t> data(new uint8_t[length > 0 ? length : 1],
+                                std::default_delete<uint8_t[]>());
+  const bool read = length >= 0 && fread(data.get(), 1, length, file) ==
+                                        static_cast<size_t>(length);
+  fclose(file);
+  if (!read) {
+    return nullptr;
+  }
+  size = length;
+  return data;
+#else
+  const int fd = open(file_name, O_RDONLY);
+  if (fd == -1) {
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  if (st.st_size == 0) {
+    // an empty mapping is an error, so point at an empty buffer instead
+    close(fd);
+    static const uint8_t empty = 0;
+    size = 0;
+    return std::shared_ptr<const void>(&empty, [](const void *) {});
+  }
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  size = st.st_size;
+  const size_t length = size;
+  return std::shared_ptr<const void>(data, [length](const void *data) {
+    munmap(const_cast<void *>(data), length);
+  });
+#endif
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace GuiSE {
+// Memory holding a whole file, unmapped or freed with the last owner. Files
+// are mapped read-only where the platform can, and read in otherwise. An
+// empty file gives size 0 and memory that is not null; a file that cannot be
+// opened gives null.
+std::shared_ptr<const void> map_file(const char *file_name, size_t &size);
+} // namespace GuiSE
@@ -0,0 +1,186 @@
+#include "memo_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace GuiSE;
+
+uint64_t GuiSE::memo_key(ValueType type, Value value) {
+  switch (type) {
+  case ValueType::Bool:
+    return value.bool_ ? 1 : 0;
+  case ValueType::Int:
+    return static_cast<uint8_t>(value.int_);
+  case ValueType::Num: {
+    uint64_t bits;
+    memcpy(&bits, &value.num, sizeof(bits));
+    return bits;
+  }
+  case ValueType::Str:
+    return reinterpret_cast<uintptr_t>(value.str);
+  default:
+    return 0;
+  }
+}
+
+namespace {
+uint64_t hash_key(const uint64_t *key, size_t length) {
+  // FNV-1a over the key words followed by a final avalanche
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ key[i]) * 0x100000001b3ull;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  return hash;
+}
+} // namespace
+
+MemoCache::MemoCache(const std::vector<ValueType> &params, size_t capacity)
+    : _params(params), _entries(capacity > 0 ? capacity : 1),
+      _keys(_entries.size() * params.size()), _scratch(params.size()) {
+  size_t buckets = 1;
+  while (buckets < _entries.size())
+    buckets <<= 1;
+  _buckets.assign(buckets, -1);
+}
+
+const Value *MemoCache::Lookup(const Value *args, int &slot) {
+  _key(args, _scratch.data());
+  const uint64_t hash = hash_key(_scratch.data(), _scratch.size());
+  int &head = _buckets[hash & (_buckets.size() - 1)];
+
+  for (int i = head; i != -1; i = _entries[i].next) {
+    Entry &entry = _entries[i];
+    if (entry.hash == hash && _equal(i, _scratch.data())) {
+      if (entry.state == State::Pending) {
+        // the same call is already in progress further up the stack
+        _stats.misses++;
+        slot = -1;
+        return nullptr;
+      }
+      _stats.hits++;
+      entry.referenced = true;
+      slot = i;
+      return &entry.result;
+    }
+  }
+
+  _stats.misses++;
+  if (!_free.empty()) {
+    slot = _free.back();
+    _free.pop_back();
+  } else if (_used < _entries.size()) {
+    slot = static_cast<int>(_used++);
+  } else {
+    slot = _evict();
+  }
+  if (slot == -1)
+    return nullptr;
+
+  Entry &entry = _entries[slot];
+  entry.hash = hash;
+  entry.state = State::Pending;
+  entry.referenced = false;
+  entry.next = head;
+  head = slot;
+  memcpy(&_keys[slot * _params.size()], _scratch.data(),
+         _params.size() * sizeof(uint64_t));
+  return nullptr;
+}
+
+void MemoCache::Fill(int slot, Value result) {
+  Entry &entry = _entries[slot];
+  entry.result = result;
+  entry.state = State::Ready;
+
+  auto &dependencies = entry.dependencies;
+  std::sort(dependencies.begin(), dependencies.end());
+  dependencies.erase(std::unique(dependencies.begin(), dependencies.end()),
+                     dependencies.end());
+}
+
+void MemoCache::Invalidate(int slot, uint32_t generation) {
+  Entry &entry = _entries[slot];
+  if (entry.generation != generation || entry.state != State::Ready)
+    return;
+
+  _unlink(slot);
+  _release(slot);
+  _free.push_back(slot);
+  _stats.invalidations++;
+}
+
+void MemoCache::Clear() {
+  for (size_t i = 0; i < _entries.size(); i++) {
+    _release(static_cast<int>(i));
+    _entries[i].next = -1;
+  }
+  _buckets.assign(_buckets.size(), -1);
+  _free.clear();
+  _hand = 0;
+  _used = 0;
+}
+
+void MemoCache::AddDependency(int slot, uint32_t global) {
+  auto &dependencies = _entries[slot].dependencies;
+  if (dependencies.empty() || dependencies.back() != global)
+    dependencies.push_back(global);
+}
+
+void MemoCache::AddDependencies(int slot, const MemoCache &cache, int from) {
+  const auto &source = cache._entries[from].dependencies;
+  auto &dependencies = _entries[slot].dependencies;
+  dependencies.insert(dependencies.end(), source.begin(), source.end());
+}
+
+void MemoCache::_key(const Value *args, uint64_t *key) const {
+  for (size_t i = 0; i < _params.size(); i++) {
+    key[i] = memo_key(_params[i], args[i]);
+  }
+}
+
+bool MemoCache::_equal(int entry, const uint64_t *key) const {
+  return memcmp(&_keys[entry * _params.size()], key,
+                _params.size() * sizeof(uint64_t)) == 0;
+}
+
+int MemoCache::_evict() {
+  // each ready entry gets one second chance before it is replaced
+  for (size_t step = 0; step < 2 * _entries.size(); step++) {
+    const int i = static_cast<int>(_hand);
+    _hand = (_hand + 1) % _entries.size();
+
+    Entry &entry = _entries[i];
+    if (entry.state == State::Pending)
+      continue;
+    if (entry.referenced) {
+      entry.referenced = false;
+      continue;
+    }
+
+    _unlink(i);
+    _release(i);
+    _stats.evictions++;
+    return i;
+  }
+  return -1;
+}
+
+void MemoCache::_unlink(int entry) {
+  int *link = &_buckets[_entries[entry].hash & (_buckets.size() - 1)];
+  while (*link != entry) {
+    link = &_entries[*link].next;
+  }
+  *link = _entries[entry].next;
+  _entries[entry].next = -1;
+}
+
+void MemoCache::_release(int entry) {
+  Entry &released = _entries[entry];
+  released.state = State::Empty;
+  released.referenced = false;
+  released.dependencies.clear();
+  released.generation++;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <guise/compiler/types.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace GuiSE {
+struct MemoStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  uint64_t invalidations = 0;
+};
+
+// Bits of value that are meaningful for type. Nums are keyed by bitwise
+// identity rather than language equality: -0 and +0 get different keys, so a
+// result that depends on the sign of zero is never shared, while identical
+// NaNs share one.
+uint64_t memo_key(ValueType type, Value value);
+
+// Bounded result cache for one memoized function, keyed by its typed argument
+// tuple. Entries are replaced with the CLOCK algorithm. A miss reserves an
+// entry that stays pending, and can't be evicted, until the call returns and
+// fills it.
+//
+// Every entry also records the global slots its result was computed from, and
+// a generation that changes whenever the entry is reused, so a dependency
+// index held elsewhere can invalidate it without keeping it alive.
+class MemoCache {
+public:
+  MemoCache(const std::vector<ValueType> &params, size_t capacity);
+
+  // Returns the cached result for args and sets slot to its entry, or returns
+  // nullptr on a miss, in which case slot is set to a reserved entry for Fill
+  // or to -1 if none is available.
+  const Value *Lookup(const Value *args, int &slot);
+  void Fill(int slot, Value result);
+  void Invalidate(int slot, uint32_t generation);
+  void Clear();
+
+  void AddDependency(int slot, uint32_t global);
+  void AddDependencies(int slot, const MemoCache &cache, int from);
+
+  inline const std::vector<uint32_t> &get_dependencies(int slot) const {
+    return _entries[slot].dependencies;
+  }
+  inline uint32_t get_generation(int slot) const {
+    return _entries[slot].generation;
+  }
+  inline const MemoStats &get_stats() const { return _stats; }
+
+  // Calls visit with every str argument and every result held, so the
+  // objects they point to can be kept alive.
+  template <typename F> void VisitValues(F visit) const {
+    const size_t arity = _params.size();
+    for (size_t i = 0; i < _entries.size(); i++) {
+      if (_entries[i].state == State::Empty)
+        continue;
+      for (size_t p = 0; p < arity; p++) {
+        if (_params[p] == ValueType::Str)
+          visit(Value(reinterpret_cast<Str *>(_keys[i * arity + p])));
+      }
+      visit(_entries[i].result);
+    }
+  }
+
+private:
+  enum class State : uint8_t { Empty, Pending, Ready };
+
+  struct Entry {
+    uint64_t hash = 0;
+    Value result;
+    int next = -1; // next entry in the same bucket
+    State state = State::Empty;
+    bool referenced = false;
+    uint32_t generation = 0;
+    std::vector<uint32_t> dependencies; // global slots read
+  };
+
+  void _key(const Value *args, uint64_t *key) const;
+  bool _equal(int entry, const uint64_t *key) const;
+  int _evict();
+  void _unlink(int entry);
+  void _release(int entry);
+
+  std::vector<ValueType> _params;
+  std::vector<Entry> _entries;
+  std::vector<uint64_t> _keys; // _params.size() words per entry
+  std::vector<int> _buckets;
+  std::vector<uint64_t> _scratch;
+  std::vector<int> _free; // invalidated entries
+  size_t _hand = 0;
+  size_t _used = 0;
+  MemoStats _stats;
+};
+} // namespace GuiSE
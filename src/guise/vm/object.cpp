@@ -1,21 +1,24 @@
 #include "object.h"
 
-using namespace GuiSE;
-
-Obj::Obj() {}
+#include <cstring>
+#include <new>
 
-Obj::~Obj() {
-  if (_next != nullptr)
-    delete _next;
-}
+using namespace GuiSE;
 
-Str::Str(const char *chars, int length)
-    : _length(length), _chars(new char[length + 1]) {
-  memcpy(_chars, chars, length);
-  _chars[_length] = '\0';
+// FNV-1a
+uint32_t Str::Hash(const char *chars, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ static_cast<uint8_t>(chars[i])) * 16777619u;
+  }
+  return hash;
 }
 
-Str::~Str() {
-  if (_chars != nullptr)
-    delete[] _chars;
+Str *Str::Place(void *memory, const char *chars, size_t length,
+                uint32_t hash) {
+  Str *str = new (memory) Str(length, hash);
+  char *str_chars = reinterpret_cast<char *>(str + 1);
+  memcpy(str_chars, chars, length);
+  str_chars[length] = '\0';
+  return str;
 }
@@ -1,30 +1,58 @@
 #pragma once
 
-#include <memory>
-#include <string>
+#include <cstddef>
+#include <cstdint>
 
 namespace GuiSE {
+class Heap;
+
+enum class ObjType : uint8_t { Str };
+
+// Header of every heap object. Objects are allocated by a Heap, which links
+// them through _next and frees them all when it is destroyed.
 class Obj {
 public:
-  Obj();
-  virtual ~Obj();
-
-  inline Obj *get_next() { return _next; }
+  inline Obj *get_next() const { return _next; }
   inline void set_next(Obj *obj) { _next = obj; }
+  inline ObjType get_type() const { return _type; }
+
+protected:
+  explicit Obj(ObjType type) : _type(type) {}
 
 private:
+  friend class Heap;
+
   Obj *_next = nullptr;
+  ObjType _type;
+  bool _marked = false; // black or gray when equal to the heap's black mark
 };
 
-class Str : Obj {
+// Immutable string, its chars stored right after the object and terminated
+// by '\0'. Strs are interned by their Heap, so two equal strs from one heap
+// are the same object and compare by pointer.
+class Str : public Obj {
 public:
-  Str(const char *chars, int length);
-  virtual ~Str();
+  // Bytes a Str of length chars takes, terminator included.
+  static constexpr size_t Size(size_t length) {
+    return sizeof(Str) + length + 1;
+  }
+  static uint32_t Hash(const char *chars, size_t length);
+  // Builds a Str in memory of at least Size(length) bytes. hash must be
+  // Hash(chars, length).
+  static Str *Place(void *memory, const char *chars, size_t length,
+                    uint32_t hash);
 
-  inline char *get_chars() const { return _chars; }
+  inline const char *get_chars() const {
+    return reinterpret_cast<const char *>(this + 1);
+  }
+  inline int get_length() const { return _length; }
+  inline uint32_t get_hash() const { return _hash; }
 
 private:
-  int _length;
-  char *_chars;
+  Str(uint32_t length, uint32_t hash)
+      : Obj(ObjType::Str), _length(length), _hash(hash) {}
+
+  uint32_t _length;
+  uint32_t _hash;
 };
-} // namespace GuiSE
\ No newline at end of file
+} // namespace GuiSE
@@ -1,33 +1,97 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
+// X-macro list of every opcode, in encoding order, as
+// X(name, operand bytes, values popped, values pushed). A pop count of -1 means
+// the count depends on the operand. A Wide prefix widens the one byte index
+// operand of the following Constant, Get/SetGlobal or Get/SetLocal to two
+// bytes. Tables indexed by opcode (such as the VM's
+// threaded dispatch table) are generated from this list so they can never fall
+// out of sync with the enum.
+#define GUISE_OPCODES(X)                                                       \
+  X(NoOp, 0, 0, 0)                                                             \
+  X(Constant, 1, 0, 1)                                                         \
+  X(GetGlobal, 1, 0, 1)                                                        \
+  X(GetLocal, 1, 0, 1)                                                         \
+  X(SetGlobal, 1, 0, 0)                                                        \
+  X(SetLocal, 1, 0, 0)                                                         \
+  X(CallDirect, 3, -1, 0)                                                      \
+  X(StackUp, 0, 0, 1)                                                          \
+  X(Pop, 0, 1, 0)                                                              \
+  X(Add, 0, 2, 1)                                                              \
+  X(Negate, 0, 1, 1)                                                           \
+  X(Multiply, 0, 2, 1)                                                         \
+  X(Divide, 0, 2, 1)                                                           \
+  X(True, 0, 0, 1)                                                             \
+  X(False, 0, 0, 1)                                                            \
+  X(Not, 0, 1, 1)                                                              \
+  X(Equal, 0, 2, 1)                                                            \
+  X(Greater, 0, 2, 1)                                                          \
+  X(Less, 0, 2, 1)                                                             \
+  X(And, 0, 2, 1)                                                              \
+  X(Or, 0, 2, 1)                                                               \
+  X(Log, 0, 1, 0)                                                              \
+  X(TypeArg, 1, 0, 0)                                                          \
+  X(Return, 0, 1, 0)                                                           \
+  X(AddLocalLocal, 2, 0, 1)                                                    \
+  X(SubtractLocalLocal, 2, 0, 1)                                               \
+  X(MultiplyLocalLocal, 2, 0, 1)                                               \
+  X(DivideLocalLocal, 2, 0, 1)                                                 \
+  X(Subtract, 0, 2, 1)                                                         \
+  X(NotEqual, 0, 2, 1)                                                         \
+  X(GreaterEqual, 0, 2, 1)                                                     \
+  X(LessEqual, 0, 2, 1)                                                        \
+  X(AddLocalConst, 2, 0, 1)                                                    \
+  X(SubtractLocalConst, 2, 0, 1)                                               \
+  X(MultiplyLocalConst, 2, 0, 1)                                               \
+  X(DivideLocalConst, 2, 0, 1)                                                 \
+  X(Wide, 0, 0, 0)                                                             \
+  X(PushZero, 0, 0, 1)                                                         \
+  X(PushSmallNum, 1, 0, 1)                                                     \
+  X(AddLocalImm, 2, 0, 1)                                                      \
+  X(SubtractLocalImm, 2, 0, 1)                                                 \
+  X(MultiplyLocalImm, 2, 0, 1)                                                 \
+  X(DivideLocalImm, 2, 0, 1)                                                   \
+  X(TailCall, 3, -1, 0)                                                        \
+  X(CallMemo, 3, -1, 0)                                                        \
+  X(ReturnMemo, 0, 1, 0)                                                       \
+  X(EqualStr, 0, 2, 1)                                                         \
+  X(Format, 3, -1, 1)
+
 namespace GuiSE {
 enum class OpCode : uint8_t {
-  NoOp,
-  Constant,
-  Global,
-  GetGlobal,
-  GetLocal,
-  SetGlobal,
-  SetLocal,
-  Call,
-  StackUp,
-  Pop,
-  Add,
-  Negate,
-  Multiply,
-  Divide,
-  True,
-  False,
-  Not,
-  Equal,
-  Greater,
-  Less,
-  And,
-  Or,
-  Log,
-  TypeArg,
-  Return,
+#define GUISE_OPCODE_ENUM(NAME, OPERANDS, POPS, PUSHES) NAME,
+  GUISE_OPCODES(GUISE_OPCODE_ENUM)
+#undef GUISE_OPCODE_ENUM
+  Count,
+};
+
+struct OpInfo {
+  const char *name;
+  uint8_t operand_bytes;
+  int8_t pops;
+  int8_t pushes;
 };
+
+inline constexpr OpInfo op_infos[] = {
+#define GUISE_OPCODE_INFO(NAME, OPERANDS, POPS, PUSHES)                        \
+  {#NAME, OPERANDS, POPS, PUSHES},
+    GUISE_OPCODES(GUISE_OPCODE_INFO)
+#undef GUISE_OPCODE_INFO
+};
+
+inline const OpInfo &op_info(OpCode op_code) {
+  return op_infos[static_cast<uint8_t>(op_code)];
+}
+
+// Length in bytes of the instruction at ip, including any Wide prefix.
+inline size_t instruction_length(const uint8_t *ip) {
+  const OpCode op_code = static_cast<OpCode>(*ip);
+  if (op_code == OpCode::Wide) {
+    return 2 + 2 * op_info(static_cast<OpCode>(ip[1])).operand_bytes;
+  }
+  return 1 + op_info(op_code).operand_bytes;
+}
 } // namespace GuiSE
@@ -0,0 +1,10 @@
+#include "program.h"
+
+using namespace GuiSE;
+
+Program::Program(ByteCode byte_code, bool jit)
+    : _byte_code(std::move(byte_code)) {
+  if (jit) {
+    _native = _jit.Compile(_byte_code);
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "byte_code.h"
+#include "jit.h"
+
+#include <vector>
+
+namespace GuiSE {
+// Compiled code frozen for sharing. Nothing in a Program changes after it is
+// constructed: the byte code, the Str constants it points to and the native
+// code are only ever read, so any number of VMs on any threads can run the
+// same Program at once. Everything a run mutates (stacks, globals, memo
+// caches) lives in the VM.
+class Program {
+public:
+  // Takes the byte code, and compiles it with the JIT once for every VM.
+  explicit Program(ByteCode byte_code, bool jit = true);
+  Program(const Program &) = delete;
+  Program &operator=(const Program &) = delete;
+
+  inline const ByteCode &get_byte_code() const { return _byte_code; }
+  // One entry per function, empty without the JIT.
+  inline const std::vector<NativeFunction> &get_native() const {
+    return _native;
+  }
+
+private:
+  const ByteCode _byte_code;
+  Jit _jit;
+  std::vector<NativeFunction> _native;
+};
+} // namespace GuiSE
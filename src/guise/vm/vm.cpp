@@ -1,16 +1,23 @@
 #include "vm.h"
 
 #include "byte_code.h"
+#include "format.h"
 #include "opcode.h"
+#include "program.h"
 
 #include <guise/debug.h>
 
+#include <algorithm>
+#include <cstdio>
+
 using namespace GuiSE;
 
 namespace {
 // basic arithmetic operator
 inline Num op_plus(Num a, Num b) { return a + b; }
 
+inline Num op_minus(Num a, Num b) { return a - b; }
+
 inline Num op_multiply(Num a, Num b) { return a * b; }
 
 inline Num op_divide(Num a, Num b) { return a / b; }
@@ -22,149 +29,627 @@ inline Bool op_greater(Num a, Num b) { return a > b; }
 
 inline Bool op_less(Num a, Num b) { return a < b; }
 
+inline Bool op_same(const Str *a, const Str *b) { return a == b; }
+
+// fused forms of the compare-and-not sequences the parser emits, so they keep
+// the same NaN behaviour
+inline Bool op_not_equal(Num a, Num b) { return !(a == b); }
+
+inline Bool op_greater_equal(Num a, Num b) { return !(a < b); }
+
+inline Bool op_less_equal(Num a, Num b) { return !(a > b); }
+
 // boolean operations
 inline Bool op_or(Bool a, Bool b) { return a || b; }
 
 inline Bool op_and(Bool a, Bool b) { return a && b; }
 } // namespace
 
-VM::VM() {
-  _regs.cf = _call_stack;
-  _regs.sp = _stack;
+VM::VM() : _stack(STACK_INIT_SIZE), _call_stack(FRAMES_INIT_SIZE) {
+  _regs.cf = _call_stack.data();
+  _regs.sp = _stack.data();
+  _stack_limit = _stack.data() + _stack.size();
+  _frames_limit = _call_stack.data() + _call_stack.size();
 }
 
 InterpretResult VM::Call(const char *function_name) {
-  const uint8_t *ip = _byte_code->GetFunction(function_name);
-  if (ip == nullptr) {
+  const int index = _byte_code->FindFunction(function_name);
+  if (index == -1) {
     printf("Function %s does not exist.", function_name);
     return InterpretResult::RuntimeError;
   }
 
-  _regs.sp++;
-  _regs.cf->fp = _regs.sp;
-  _regs.cf->ip = ip;
+  // reserve the return slot, then drop it once the call completes
+  const FunctionEntry &function = _functions[index];
+  Value *fp = _regs.sp + 1;
+  if (function.native != nullptr) {
+    _reserve(_regs, fp, function.native_stack);
+    function.native(fp);
+    return InterpretResult::Ok;
+  }
+
+  _reserve(_regs, fp, function.max_stack);
+  _regs.sp = fp;
+  _regs.cf->fp = fp;
+  _regs.cf->ip = function.ip;
+  _regs.cf->memo_slot = -1;
 
   InterpretResult result = Run();
+  _regs.sp--;
 
   return result;
 }
 
-void VM::set_byte_code(const ByteCode &byte_code) { _byte_code = &byte_code; }
+InterpretResult VM::Call(int function, const Value *args, size_t argc,
+                         Value &result) {
+  const FunctionEntry &entry = _functions[function];
+  Value *fp = _regs.sp + 1;
+  if (entry.native != nullptr) {
+    _reserve(_regs, fp, std::max<int>(entry.native_stack, argc));
+    std::copy(args, args + argc, fp);
+    entry.native(fp);
+    result = fp[-1];
+    return InterpretResult::Ok;
+  }
+
+  _reserve(_regs, fp, std::max<int>(entry.max_stack, argc));
+  std::copy(args, args + argc, fp);
+  _regs.sp = fp + argc;
+  _regs.cf->fp = fp;
+  _regs.cf->ip = entry.ip;
+  _regs.cf->memo_slot = -1;
+
+  const InterpretResult status = Run();
+  result = *--_regs.sp;
+  return status;
+}
+
+InterpretResult VM::CallBatch(int function, const Num *const *args,
+                              size_t rows, Num *results) {
+  if (!_batch.CanRun(function))
+    return InterpretResult::RuntimeError;
+  _batch.Run(function, _stack.data(), args, rows, results);
+  return InterpretResult::Ok;
+}
+
+void VM::set_byte_code(const ByteCode &byte_code) {
+  _program.reset();
+  _load(byte_code, _jit_enabled ? _jit.Compile(byte_code)
+                                : std::vector<NativeFunction>());
+}
+
+void VM::set_program(std::shared_ptr<const Program> program) {
+  _program = std::move(program);
+  _load(_program->get_byte_code(), _program->get_native());
+}
+
+void VM::_load(const ByteCode &byte_code,
+               const std::vector<NativeFunction> &native) {
+  _byte_code = &byte_code;
+  _batch.set_byte_code(&byte_code);
+  _heap.set_base(byte_code.GetHeap());
+
+  // resolve every function once so calls index straight into the code
+  _functions.assign(byte_code.FunctionCount(), FunctionEntry());
+  _memo_caches.clear();
+  _memo_caches.resize(_functions.size());
+  for (size_t i = 0; i < _functions.size(); i++) {
+    const Function &function = byte_code.GetFunctionInfo(i);
+    _functions[i].ip = byte_code[function.offset];
+    _functions[i].max_stack = function.max_stack;
+    if (function.memoized) {
+      _memo_caches[i] =
+          std::make_unique<MemoCache>(function.params, _memo_capacity);
+    }
+    _functions[i].memo = _memo_caches[i].get();
+  }
+
+  for (size_t i = 0; i < native.size(); i++) {
+    _functions[i].native = native[i].entry;
+    _functions[i].native_stack = native[i].stack;
+  }
+  _memo_frames.clear();
+  _dependents.assign(byte_code.GlobalCount(), {});
+}
+
+const MemoStats *VM::GetMemoStats(const char *function_name) const {
+  const int index = _byte_code->FindFunction(function_name);
+  if (index == -1 || _memo_caches[index] == nullptr)
+    return nullptr;
+  return &_memo_caches[index]->get_stats();
+}
+
+void VM::ClearMemo() {
+  for (auto &cache : _memo_caches) {
+    if (cache != nullptr)
+      cache->Clear();
+  }
+  for (auto &dependents : _dependents) {
+    dependents.clear();
+  }
+}
+
+bool VM::SetGlobal(const char *global_name, Value value) {
+  const int index = _byte_code->FindGlobal(global_name);
+  if (index == -1) {
+    printf("Global %s does not exist.", global_name);
+    return false;
+  }
+
+  // writing the same value keeps everything computed from it
+  const ValueType type = _byte_code->GetGlobalInfo(index).type;
+  if (memo_key(type, _stack[index]) == memo_key(type, value))
+    return true;
+
+  _stack[index] = value;
+  if (!_dependents[index].empty())
+    _invalidate(index);
+  return true;
+}
+
+bool VM::CollectStep(size_t budget) {
+  return _heap.Step(budget, [this](Heap &heap) { _mark_roots(heap); });
+}
+
+void VM::Collect() {
+  const auto mark_roots = [this](Heap &heap) { _mark_roots(heap); };
+  if (_heap.get_phase() != GcPhase::Idle)
+    _heap.Step(SIZE_MAX, mark_roots);
+  _heap.Step(SIZE_MAX, mark_roots, true);
+}
+
+// Globals and constants are typed, but the rest of the stack is scanned
+// conservatively: any slot that points at an object keeps it alive.
+void VM::_mark_roots(Heap &heap) {
+  if (_byte_code == nullptr)
+    return;
+
+  Value *const globals_end = _stack.data() + _byte_code->GlobalCount();
+  for (size_t i = 0; i < _byte_code->GlobalCount(); i++) {
+    if (_byte_code->GetGlobalInfo(i).type == ValueType::Str)
+      heap.Mark(_stack[i]);
+  }
+  for (const Value *slot = globals_end; slot < _regs.sp; slot++) {
+    heap.Mark(*slot);
+  }
+  heap.Mark(_regs.va);
+  heap.Mark(_regs.vb);
+
+  for (size_t i = 0; i < _byte_code->ConstantCount(); i++) {
+    if (_byte_code->GetConstantType(i) == ValueType::Str)
+      heap.Mark(_byte_code->GetConstant(i));
+  }
+  for (const auto &cache : _memo_caches) {
+    if (cache != nullptr)
+      cache->VisitValues([&heap](Value value) { heap.Mark(value); });
+  }
+}
+
+// Formats into a buffer kept between calls and interns the result, so the
+// only allocation is the str itself, and none if an equal str exists.
+Str *VM::_format(const FormatPlan &plan, const Value *args) {
+  const size_t bound = format_bound(plan, args) + 1;
+  if (_format_buffer.size() < bound)
+    _format_buffer.resize(bound);
+  const size_t length = format(plan, args, _format_buffer.data());
+  return _heap.NewStr(_format_buffer.data(), length);
+}
+
+void VM::_grow(Registers &regs, Value *&fp, int slots) {
+  Value *old_stack = _stack.data();
+  const size_t needed = (fp - old_stack) + slots;
+  if (needed > _stack.size()) {
+    size_t size = _stack.size();
+    while (size < needed)
+      size *= 2;
+    _stack.resize(size);
+
+    Value *stack = _stack.data();
+    regs.sp = stack + (regs.sp - old_stack);
+    fp = stack + (fp - old_stack);
+    for (CallFrame *cf = _call_stack.data(); cf <= regs.cf; cf++) {
+      if (cf->fp != nullptr)
+        cf->fp = stack + (cf->fp - old_stack);
+    }
+    _stack_limit = stack + _stack.size();
+  }
+
+  if (regs.cf + 1 == _frames_limit) {
+    const size_t depth = regs.cf - _call_stack.data();
+    _call_stack.resize(_call_stack.size() * 2);
+    regs.cf = _call_stack.data() + depth;
+    _frames_limit = _call_stack.data() + _call_stack.size();
+  }
+}
+
+namespace {
+// Stack form: pops b into vb, reads a into va and replaces a with the result.
+template <auto Value::*member, typename F>
+inline void binary_op(Registers &regs, F f) {
+  regs.vb = *--regs.sp;
+  regs.va = regs.sp[-1];
+  regs.sp[-1] = f(regs.va.*member, regs.vb.*member);
+}
+
+// Register form: both operands are locals loaded straight into va and vb, so
+// only the result touches the operand stack.
+template <auto Value::*member, typename F>
+inline void register_op(Registers &regs, const Value *fp, const uint8_t *&ip,
+                        F f) {
+  regs.va = fp[ip[0]];
+  regs.vb = fp[ip[1]];
+  ip += 2;
+  *regs.sp++ = f(regs.va.*member, regs.vb.*member);
+}
+
+// Register form with a local in va and a constant in vb.
+template <auto Value::*member, typename F>
+inline void register_const_op(Registers &regs, const Value *fp,
+                              const uint8_t *&ip, const ByteCode &byte_code,
+                              F f) {
+  regs.va = fp[ip[0]];
+  regs.vb = byte_code.GetConstant(ip[1]);
+  ip += 2;
+  *regs.sp++ = f(regs.va.*member, regs.vb.*member);
+}
+
+// Register form with a local in va and a small whole number immediate in vb.
+template <typename F>
+inline void register_imm_op(Registers &regs, const Value *fp,
+                            const uint8_t *&ip, F f) {
+  regs.va = fp[ip[0]];
+  regs.vb = static_cast<Num>(static_cast<int8_t>(ip[1]));
+  ip += 2;
+  *regs.sp++ = f(regs.va.num, regs.vb.num);
+}
+} // namespace
+
+// The interpreter works on a local copy of the register file plus the current
+// frame's ip and fp so they can stay in machine registers; they are written
+// back whenever control leaves Run or switches frames.
+//
+// With threaded dispatch every handler ends in its own indirect jump through
+// the label table, giving the branch predictor one history per opcode instead
+// of the single shared jump of the switch.
+#ifdef GUISE_THREADED_DISPATCH
+#define VM_DISPATCH() goto *dispatch_table[*ip++];
+#define VM_CASE(OP) op_##OP:
+#define VM_NEXT() goto *dispatch_table[*ip++]
+#else
+#define VM_DISPATCH() switch (static_cast<OpCode>(*ip++))
+#define VM_CASE(OP) case OpCode::OP:
+#define VM_NEXT() break
+#endif
 
 InterpretResult VM::Run() {
+#ifdef GUISE_THREADED_DISPATCH
+#define GUISE_OPCODE_LABEL(NAME, OPERANDS, POPS, PUSHES) &&op_##NAME,
+  static void *dispatch_table[] = {GUISE_OPCODES(GUISE_OPCODE_LABEL)};
+#undef GUISE_OPCODE_LABEL
+  static_assert(sizeof(dispatch_table) / sizeof(dispatch_table[0]) ==
+                    static_cast<size_t>(OpCode::Count),
+                "dispatch table out of sync with OpCode");
+#endif
+
+  GUISE_ASSERT(_regs.cf != nullptr)
+  Registers regs = _regs;
+  const uint8_t *ip = regs.cf->ip;
+  Value *fp = regs.cf->fp;
+
   for (;;) {
-    OpCode op_code;
-    switch (op_code = _read<OpCode>()) {
-    case OpCode::Constant: {
-      const Value value = _byte_code->GetConstant(_read());
-      _push(value);
-    } break;
-    case OpCode::GetGlobal:
-      _push(_stack[_read()]);
-      break;
-    case OpCode::GetLocal:
-      _push(_regs.cf->fp[_read()]);
-      break;
-    case OpCode::SetGlobal:
-      _stack[_read()] = _pop();
-      break;
-    case OpCode::SetLocal:
-      _regs.cf->fp[_read()] = _pop();
-      break;
-    case OpCode::Call: {
-      const Int fn_ptr = _pop().int_;
-      const int arg_count = _read();
-      _regs.sp -= arg_count;
-      _regs.cf++;
-      _regs.cf->ip = (*_byte_code)[fn_ptr];
-      _regs.cf->fp = _regs.sp;
-    } break;
-    case OpCode::StackUp:
-      _regs.sp++;
-      break;
-    case OpCode::Pop:
-      _pop();
-      break;
-    case OpCode::Add:
-      _binary_op<&Value::num>(op_plus);
-      break;
-    case OpCode::Negate:
-      _push(-_pop().num);
-      break;
-    case OpCode::Multiply:
-      _binary_op<&Value::num>(op_multiply);
-      break;
-    case OpCode::Divide:
-      _binary_op<&Value::num>(op_divide);
-      break;
-    case OpCode::True:
-      _push(true);
-      break;
-    case OpCode::False:
-      _push(false);
-      break;
-    case OpCode::Not:
-      _push(!_pop().bool_);
-      break;
-    case OpCode::Equal:
-      _binary_op<&Value::num>(op_equal);
-      break;
-    case OpCode::Greater:
-      _binary_op<&Value::num>(op_greater);
-      break;
-    case OpCode::Less:
-      _binary_op<&Value::num>(op_less);
-      break;
-    case OpCode::And:
-      _binary_op<&Value::bool_>(op_and);
-      break;
-    case OpCode::Or:
-      _binary_op<&Value::bool_>(op_or);
-      break;
-    case OpCode::Log:
-      log_value(_regs.tr, _pop());
-      break;
-    case OpCode::TypeArg:
-      _regs.tr = _read<ValueType>();
-      break;
-    case OpCode::Return:
-      _regs.cf->fp[-1] = _pop();
-      if (_regs.cf == _call_stack)
+    VM_DISPATCH() {
+      VM_CASE(Constant) { *regs.sp++ = _byte_code->GetConstant(*ip++); }
+      VM_NEXT();
+      VM_CASE(GetGlobal) {
+        if (regs.md != 0)
+          _track_global(*ip);
+        *regs.sp++ = _stack[*ip++];
+      }
+      VM_NEXT();
+      VM_CASE(GetLocal) { *regs.sp++ = fp[*ip++]; }
+      VM_NEXT();
+      VM_CASE(SetGlobal) {
+        _stack[*ip] = regs.sp[-1];
+        if (!_dependents[*ip].empty())
+          _invalidate(*ip);
+        ip++;
+      }
+      VM_NEXT();
+      VM_CASE(SetLocal) { fp[*ip++] = regs.sp[-1]; }
+      VM_NEXT();
+      VM_CASE(CallDirect) {
+        // arguments stay where they are and become the callee's first locals
+        const FunctionEntry &callee = _functions[ip[0] | ip[1] << 8];
+        const int arg_count = ip[2];
+        if (callee.native != nullptr) {
+          Value *args = regs.sp - arg_count;
+          _reserve(regs, args, callee.native_stack);
+          fp = regs.cf->fp;
+          callee.native(args);
+          regs.sp = args;
+          ip += 3;
+          VM_NEXT();
+        }
+        regs.cf->ip = ip + 3;
+        fp = regs.sp - arg_count;
+        _reserve(regs, fp, callee.max_stack);
+        regs.cf++;
+        ip = callee.ip;
+        regs.cf->ip = ip;
+        regs.cf->fp = fp;
+      }
+      VM_NEXT();
+      VM_CASE(StackUp) { regs.sp++; }
+      VM_NEXT();
+      VM_CASE(Pop) { regs.sp--; }
+      VM_NEXT();
+      VM_CASE(Add) { binary_op<&Value::num>(regs, op_plus); }
+      VM_NEXT();
+      VM_CASE(Negate) { regs.sp[-1] = -regs.sp[-1].num; }
+      VM_NEXT();
+      VM_CASE(Multiply) { binary_op<&Value::num>(regs, op_multiply); }
+      VM_NEXT();
+      VM_CASE(Divide) { binary_op<&Value::num>(regs, op_divide); }
+      VM_NEXT();
+      VM_CASE(True) { *regs.sp++ = true; }
+      VM_NEXT();
+      VM_CASE(False) { *regs.sp++ = false; }
+      VM_NEXT();
+      VM_CASE(Not) { regs.sp[-1] = !regs.sp[-1].bool_; }
+      VM_NEXT();
+      VM_CASE(Equal) { binary_op<&Value::num>(regs, op_equal); }
+      VM_NEXT();
+      // interned, so equal strs are the same object
+      VM_CASE(EqualStr) { binary_op<&Value::str>(regs, op_same); }
+      VM_NEXT();
+      VM_CASE(Greater) { binary_op<&Value::num>(regs, op_greater); }
+      VM_NEXT();
+      VM_CASE(Less) { binary_op<&Value::num>(regs, op_less); }
+      VM_NEXT();
+      VM_CASE(And) { binary_op<&Value::bool_>(regs, op_and); }
+      VM_NEXT();
+      VM_CASE(Or) { binary_op<&Value::bool_>(regs, op_or); }
+      VM_NEXT();
+      VM_CASE(Log) { log_value(regs.tr, *--regs.sp); }
+      VM_NEXT();
+      VM_CASE(TypeArg) { regs.tr = static_cast<ValueType>(*ip++); }
+      VM_NEXT();
+      VM_CASE(ReturnMemo) {
+        if (regs.cf->memo_slot != -1)
+          _memo_return(regs, regs.sp[-1]);
+      }
+      // falls through to Return
+      VM_CASE(Return) {
+        fp[-1] = *--regs.sp;
+        if (!_return(regs, ip, fp)) {
+          regs.cf->ip = ip;
+          _regs = regs;
+          return InterpretResult::Ok;
+        }
+      }
+      VM_NEXT();
+      VM_CASE(AddLocalLocal) {
+        register_op<&Value::num>(regs, fp, ip, op_plus);
+      }
+      VM_NEXT();
+      VM_CASE(SubtractLocalLocal) {
+        register_op<&Value::num>(regs, fp, ip, op_minus);
+      }
+      VM_NEXT();
+      VM_CASE(MultiplyLocalLocal) {
+        register_op<&Value::num>(regs, fp, ip, op_multiply);
+      }
+      VM_NEXT();
+      VM_CASE(DivideLocalLocal) {
+        register_op<&Value::num>(regs, fp, ip, op_divide);
+      }
+      VM_NEXT();
+      VM_CASE(Subtract) { binary_op<&Value::num>(regs, op_minus); }
+      VM_NEXT();
+      VM_CASE(NotEqual) { binary_op<&Value::num>(regs, op_not_equal); }
+      VM_NEXT();
+      VM_CASE(GreaterEqual) {
+        binary_op<&Value::num>(regs, op_greater_equal);
+      }
+      VM_NEXT();
+      VM_CASE(LessEqual) { binary_op<&Value::num>(regs, op_less_equal); }
+      VM_NEXT();
+      VM_CASE(AddLocalConst) {
+        register_const_op<&Value::num>(regs, fp, ip, *_byte_code, op_plus);
+      }
+      VM_NEXT();
+      VM_CASE(SubtractLocalConst) {
+        register_const_op<&Value::num>(regs, fp, ip, *_byte_code, op_minus);
+      }
+      VM_NEXT();
+      VM_CASE(MultiplyLocalConst) {
+        register_const_op<&Value::num>(regs, fp, ip, *_byte_code,
+                                       op_multiply);
+      }
+      VM_NEXT();
+      VM_CASE(DivideLocalConst) {
+        register_const_op<&Value::num>(regs, fp, ip, *_byte_code, op_divide);
+      }
+      VM_NEXT();
+      VM_CASE(Wide) {
+        const OpCode op_code = static_cast<OpCode>(ip[0]);
+        const uint16_t index = ip[1] | ip[2] << 8;
+        ip += 3;
+        switch (op_code) {
+        case OpCode::Constant:
+          *regs.sp++ = _byte_code->GetConstant(index);
+          break;
+        case OpCode::GetGlobal:
+          if (regs.md != 0)
+            _track_global(index);
+          *regs.sp++ = _stack[index];
+          break;
+        case OpCode::GetLocal:
+          *regs.sp++ = fp[index];
+          break;
+        case OpCode::SetGlobal:
+          _stack[index] = regs.sp[-1];
+          if (!_dependents[index].empty())
+            _invalidate(index);
+          break;
+        case OpCode::SetLocal:
+          fp[index] = regs.sp[-1];
+          break;
+        }
+      }
+      VM_NEXT();
+      VM_CASE(PushZero) { *regs.sp++ = Num(0); }
+      VM_NEXT();
+      VM_CASE(PushSmallNum) {
+        *regs.sp++ = static_cast<Num>(static_cast<int8_t>(*ip++));
+      }
+      VM_NEXT();
+      VM_CASE(AddLocalImm) { register_imm_op(regs, fp, ip, op_plus); }
+      VM_NEXT();
+      VM_CASE(SubtractLocalImm) { register_imm_op(regs, fp, ip, op_minus); }
+      VM_NEXT();
+      VM_CASE(MultiplyLocalImm) {
+        register_imm_op(regs, fp, ip, op_multiply);
+      }
+      VM_NEXT();
+      VM_CASE(DivideLocalImm) { register_imm_op(regs, fp, ip, op_divide); }
+      VM_NEXT();
+      VM_CASE(TailCall) {
+        // the callee takes over this frame: arguments move down to fp and its
+        // result is returned straight to our caller
+        const FunctionEntry &callee = _functions[ip[0] | ip[1] << 8];
+        const int arg_count = ip[2];
+        std::copy(regs.sp - arg_count, regs.sp, fp);
+        regs.sp = fp + arg_count;
+        if (callee.native != nullptr) {
+          _reserve(regs, fp, callee.native_stack);
+          callee.native(fp);
+          if (!_return(regs, ip, fp)) {
+            regs.cf->ip = ip;
+            _regs = regs;
+            return InterpretResult::Ok;
+          }
+          VM_NEXT();
+        }
+        _reserve(regs, fp, callee.max_stack);
+        ip = callee.ip;
+        regs.cf->ip = ip;
+      }
+      VM_NEXT();
+      VM_CASE(CallMemo) {
+        const FunctionEntry &callee = _functions[ip[0] | ip[1] << 8];
+        Value *args = regs.sp - ip[2];
+        int slot;
+        if (const Value *result = callee.memo->Lookup(args, slot)) {
+          // drop the arguments and leave the result in the StackUp slot
+          if (regs.md != 0)
+            _memo_hit(*callee.memo, slot);
+          args[-1] = *result;
+          regs.sp = args;
+          ip += 3;
+        } else {
+          regs.cf->ip = ip + 3;
+          fp = args;
+          _reserve(regs, fp, callee.max_stack);
+          regs.cf++;
+          ip = callee.ip;
+          regs.cf->ip = ip;
+          regs.cf->fp = fp;
+          regs.cf->memo = callee.memo;
+          regs.cf->memo_slot = slot;
+          if (slot != -1) {
+            _memo_frames.push_back({callee.memo, slot});
+            regs.md++;
+          }
+        }
+      }
+      VM_NEXT();
+      // the slot values are replaced by the formatted str
+      VM_CASE(Format) {
+        const FormatPlan &plan = _byte_code->GetFormat(ip[0] | ip[1] << 8);
+        Value *args = regs.sp - ip[2];
+        ip += 3;
+        *args = _format(plan, args);
+        regs.sp = args + 1;
+      }
+      VM_NEXT();
+      VM_CASE(NoOp) {
+        regs.cf->ip = ip;
+        _regs = regs;
         return InterpretResult::Ok;
-      _regs.cf--;
-      break;
-    case OpCode::Global:
-      return InterpretResult::Ok;
-    case OpCode::NoOp:
-      return InterpretResult::Ok;
-#ifdef GUISE_DEBUG
+      }
+#if defined(GUISE_DEBUG) && !defined(GUISE_THREADED_DISPATCH)
     default:
-      printf("opcode %d not implemented.", op_code);
+      printf("opcode %d not implemented.", *(ip - 1));
       return InterpretResult::RuntimeError;
 #endif
     }
   }
 }
 
+#undef VM_DISPATCH
+#undef VM_CASE
+#undef VM_NEXT
+
+// Each initializer leaves its value on the stack, so running them in order
+// fills the global slots from the bottom of the stack up.
 InterpretResult VM::RunGlobal() {
-  _regs.cf->ip = (*_byte_code)[0];
-  OpCode last_op_code = OpCode::Global;
-  while (last_op_code != OpCode::NoOp) {
-    const OpCode op_code = _read<OpCode>();
-    switch (op_code) {
-    case OpCode::Global:
-      Run();
-      break;
-    case OpCode::Constant:
-    case OpCode::TypeArg:
-    case OpCode::GetGlobal:
-    case OpCode::GetLocal:
-      _read();
-      break;
+  Value *fp = _stack.data();
+  _reserve(_regs, fp, _byte_code->GetGlobalMaxStack());
+  _regs.cf->ip = (*_byte_code)[_byte_code->GetGlobalInit()];
+  return Run();
+}
+
+void VM::_track_global(int global) {
+  const MemoFrame &frame = _memo_frames.back();
+  frame.cache->AddDependency(frame.slot, global);
+}
+
+// A cached result used while computing another one passes on its dependencies.
+void VM::_memo_hit(const MemoCache &cache, int slot) {
+  const MemoFrame &frame = _memo_frames.back();
+  frame.cache->AddDependencies(frame.slot, cache, slot);
+}
+
+void VM::_memo_return(Registers &regs, Value result) {
+  MemoCache *cache = regs.cf->memo;
+  const int slot = regs.cf->memo_slot;
+  cache->Fill(slot, result);
+  _memo_frames.pop_back();
+  regs.md--;
+
+  _watch(cache, slot);
+  if (regs.md != 0)
+    _memo_hit(*cache, slot);
+}
+
+namespace {
+bool is_stale(const Dependent &dependent) {
+  return dependent.cache->get_generation(dependent.slot) !=
+         dependent.generation;
+}
+} // namespace
+
+void VM::_watch(MemoCache *cache, int slot) {
+  const uint32_t generation = cache->get_generation(slot);
+  for (const uint32_t global : cache->get_dependencies(slot)) {
+    auto &dependents = _dependents[global];
+    // drop entries evicted since they were added before the list grows
+    if (dependents.size() == dependents.capacity()) {
+      dependents.erase(
+          std::remove_if(dependents.begin(), dependents.end(), is_stale),
+          dependents.end());
     }
-    last_op_code = static_cast<OpCode>(*(_regs.cf->ip - 1));
+    dependents.push_back({cache, slot, generation});
+  }
+}
+
+void VM::_invalidate(int global) {
+  std::vector<Dependent> dependents;
+  dependents.swap(_dependents[global]);
+  for (const Dependent &dependent : dependents) {
+    dependent.cache->Invalidate(dependent.slot, dependent.generation);
   }
-  return InterpretResult();
 }
 
 void VM::_push(Value value) {
@@ -1,20 +1,59 @@
 #pragma once
 
+#include "batch.h"
+#include "heap.h"
+#include "jit.h"
+#include "memo_cache.h"
+
 #include <guise/compiler/types.h>
 #include <guise/debug.h>
 
-#define STACK_MAX 256
-#define FRAMES_MAX 64
+#include <memory>
+#include <vector>
+
+// initial sizes, both stacks grow on demand
+#define STACK_INIT_SIZE 256
+#define FRAMES_INIT_SIZE 64
+// default number of cached results per memoized function
+#define MEMO_INIT_CAPACITY 1024
 
 namespace GuiSE {
 class ByteCode;
 class Obj;
+class Program;
+class Str;
+struct FormatPlan;
 
 enum class InterpretResult { Ok, CompileError, RuntimeError };
 
 struct CallFrame {
   const uint8_t *ip = nullptr;
   Value *fp = nullptr;
+  MemoCache *memo = nullptr; // cache awaiting this frame's result
+  int memo_slot = -1;
+};
+
+struct FunctionEntry {
+  const uint8_t *ip = nullptr;
+  int max_stack = 0;         // operand stack slots used by one activation
+  MemoCache *memo = nullptr; // set for memoized functions
+  NativeFn native = nullptr; // set for functions compiled by the JIT
+  int native_stack = 0;
+};
+
+// A memo entry whose result is being computed; global reads are recorded
+// against the innermost one.
+struct MemoFrame {
+  MemoCache *cache = nullptr;
+  int slot = -1;
+};
+
+// A memo entry to invalidate when a global changes. Stale if the entry's
+// generation has moved on.
+struct Dependent {
+  MemoCache *cache = nullptr;
+  int slot = -1;
+  uint32_t generation = 0;
 };
 
 struct Registers {
@@ -23,6 +62,7 @@ struct Registers {
   Value va;                          // a register
   Value vb;                          // b register
   ValueType tr = ValueType::Invalid; // type register
+  int md = 0;                        // memo frames being tracked
 };
 
 class VM {
@@ -32,8 +72,46 @@ public:
   InterpretResult Run();
   InterpretResult RunGlobal();
   InterpretResult Call(const char *function_name);
+  // Calls the function with the given index, its argc arguments copied from
+  // args, and stores its return value in result.
+  InterpretResult Call(int function, const Value *args, size_t argc,
+                       Value &result);
+  // Calls the function once per row with the SIMD batch interpreter,
+  // argument p of row r read from args[p][r], storing each result in
+  // results[r]. Bools are passed and returned as 0 or 1. Fails unless the
+  // function only computes on num and bool values (see Batch).
+  InterpretResult CallBatch(int function, const Num *const *args, size_t rows,
+                            Num *results);
 
   void set_byte_code(const ByteCode &byte_code);
+  // Runs a shared program, using its native code instead of compiling it
+  // again. The VM keeps the program alive.
+  void set_program(std::shared_ptr<const Program> program);
+
+  // Both apply from the next set_byte_code.
+  inline void set_memo_capacity(size_t capacity) {
+    _memo_capacity = capacity;
+  }
+  inline void set_jit_enabled(bool enabled) { _jit_enabled = enabled; }
+  const MemoStats *GetMemoStats(const char *function_name) const;
+  void ClearMemo();
+
+  // Updates a global after RunGlobal. Cached results that read it are
+  // invalidated if the value changed, so the next call only recomputes them.
+  bool SetGlobal(const char *global_name, Value value);
+
+  // Objects made while running, such as str arguments passed in by the host.
+  // The collector frees those no longer reachable from the stack, globals,
+  // constants or memo caches, so the host must not hold on to one past the
+  // next collection without storing it in the VM.
+  inline Heap &get_heap() { return _heap; }
+  // Does up to budget units of incremental collection, starting a cycle once
+  // the heap has grown enough. Meant to be called between frames; returns
+  // whether a cycle is still in progress.
+  bool CollectStep(size_t budget = GC_STEP_WORK);
+  // Finishes any cycle in progress, then runs a whole one.
+  void Collect();
+  inline const GcStats &get_gc_stats() const { return _heap.get_stats(); }
 
 private:
   template <typename T> inline T _read() { return static_cast<T>(_read()); }
@@ -45,15 +123,53 @@ private:
   void _push(Value value);
   Value _pop();
 
-  template <auto Value::*member, typename F> inline void _binary_op(F f) {
-    const auto b = _pop().*member;
-    const auto a = _pop().*member;
-    _push(f(a, b));
+  // Makes room for a frame using slots stack slots from fp plus one more call
+  // frame, rebasing every stack pointer if either stack has to move.
+  inline void _reserve(Registers &regs, Value *&fp, int slots) {
+    if (fp + slots > _stack_limit || regs.cf + 1 == _frames_limit)
+      _grow(regs, fp, slots);
   }
+  void _grow(Registers &regs, Value *&fp, int slots);
+
+  // Pops the current frame once its result is in fp[-1]. Returns false, leaving
+  // the frame in place, if it is the outermost one.
+  inline bool _return(Registers &regs, const uint8_t *&ip, Value *&fp) {
+    regs.sp = fp;
+    if (regs.cf == _call_stack.data())
+      return false;
+    regs.cf--;
+    ip = regs.cf->ip;
+    fp = regs.cf->fp;
+    return true;
+  }
+
+  void _load(const ByteCode &byte_code,
+             const std::vector<NativeFunction> &native);
+
+  void _mark_roots(Heap &heap);
+  Str *_format(const FormatPlan &plan, const Value *args);
+  void _track_global(int global);
+  void _memo_hit(const MemoCache &cache, int slot);
+  void _memo_return(Registers &regs, Value result);
+  void _watch(MemoCache *cache, int slot);
+  void _invalidate(int global);
 
   Registers _regs;
   const ByteCode *_byte_code = nullptr;
-  Value _stack[STACK_MAX];
-  CallFrame _call_stack[FRAMES_MAX];
+  std::shared_ptr<const Program> _program;
+  std::vector<FunctionEntry> _functions; // resolved by function index
+  std::vector<std::unique_ptr<MemoCache>> _memo_caches;
+  size_t _memo_capacity = MEMO_INIT_CAPACITY;
+  std::vector<MemoFrame> _memo_frames;
+  std::vector<std::vector<Dependent>> _dependents; // by global slot
+  Jit _jit;
+  Batch _batch;
+  Heap _heap;
+  std::vector<char> _format_buffer; // grows to the longest format output
+  bool _jit_enabled = true;
+  std::vector<Value> _stack;
+  std::vector<CallFrame> _call_stack;
+  const Value *_stack_limit = nullptr;
+  const CallFrame *_frames_limit = nullptr;
 };
 } // namespace GuiSE
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "vm_pool.h"
+
+#include "byte_code.h"
+#include "object.h"
+#include "program.h"
+
+#include <algorithm>
+
+using namespace GuiSE;
+
+VMPool::VMPool(std::shared_ptr<const Program> program, unsigned threads)
+    : _program(std::move(program)) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned i = 0; i < threads; i++) {
+    _workers.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < _workers.size(); i++) {
+    _workers[i]->thread = std::thread(&VMPool::_run, this, i);
+  }
+}
+
+VMPool::~VMPool() {
+  {
+    std::lock_guard<std::mutex> lock(_sleep_mutex);
+    _stopping = true;
+  }
+  _wake.notify_all();
+  for (auto &worker : _workers) {
+    worker->thread.join();
+  }
+}
+
+std::future<CallResult> VMPool::Submit(const char *function_name,
+                                       std::vector<Value> args) {
+  return Submit(_program->get_byte_code().FindFunction(function_name),
+                std::move(args));
+}
+
+std::future<CallResult> VMPool::Submit(int function,
+                                       std::vector<Value> args) {
+  if (function < 0 ||
+      static_cast<size_t>(function) >=
+          _program->get_byte_code().FunctionCount()) {
+    std::promise<CallResult> result;
+    result.set_value({InterpretResult::RuntimeError, Value()});
+    return result.get_future();
+  }
+
+  Job job{function, std::move(args), {}};
+  std::future<CallResult> result = job.result.get_future();
+
+  // counted before it is queued so _take never sees the count go below zero
+  {
+    std::lock_guard<std::mutex> lock(_sleep_mutex);
+    _pending++;
+  }
+  Worker &worker = *_workers[_next_worker++ % _workers.size()];
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.jobs.push_back(std::move(job));
+  }
+  _wake.notify_one();
+  return result;
+}
+
+// Takes the oldest job queued on this worker, or else steals the newest one
+// queued on another, leaving the others' oldest jobs to their owners.
+bool VMPool::_take(size_t index, Job &job) {
+  for (size_t i = 0; i < _workers.size(); i++) {
+    Worker &worker = *_workers[(index + i) % _workers.size()];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.jobs.empty())
+      continue;
+    if (i == 0) {
+      job = std::move(worker.jobs.front());
+      worker.jobs.pop_front();
+    } else {
+      job = std::move(worker.jobs.back());
+      worker.jobs.pop_back();
+    }
+    _pending--;
+    return true;
+  }
+  return false;
+}
+
+void VMPool::_run(size_t index) {
+  VM vm;
+  vm.set_program(_program);
+  vm.RunGlobal();
+
+  const ByteCode &byte_code = _program->get_byte_code();
+  for (;;) {
+    Job job;
+    if (!_take(index, job)) {
+      std::unique_lock<std::mutex> lock(_sleep_mutex);
+      _wake.wait(lock, [this] { return _pending > 0 || _stopping; });
+      if (_pending == 0 && _stopping)
+        return;
+      continue;
+    }
+
+    CallResult result;
+    const Function &function = byte_code.GetFunctionInfo(job.function);
+    if (job.args.size() != function.arity) {
+      result.status = InterpretResult::RuntimeError;
+    } else {
+      result.status = vm.Call(job.function, job.args.data(), job.args.size(),
+                              result.value);
+      if (result.status == InterpretResult::Ok &&
+          function.return_type == ValueType::Str) {
+        result.str.assign(result.value.str->get_chars(),
+                          result.value.str->get_length());
+        result.value = Value();
+      }
+    }
+    job.result.set_value(std::move(result));
+    vm.CollectStep(GC_STEP_WORK);
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "vm.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GuiSE {
+class Program;
+
+struct CallResult {
+  InterpretResult status = InterpretResult::Ok;
+  // unset for a str result, whose object belongs to the worker's heap
+  Value value;
+  // the chars of a str result, copied out before the worker collects
+  std::string str;
+};
+
+// Runs calls into one shared Program on a fixed set of worker threads. Each
+// worker owns a VM, which runs the program's global initializers once when the
+// worker starts, so globals and memo caches are per worker rather than per
+// call. Calls are queued on the workers in turn, and a worker that runs out of
+// calls steals the newest ones queued on the others, leaving their oldest to
+// their owners. Each worker does a step of collection after every call.
+class VMPool {
+public:
+  // 0 threads starts one worker per hardware thread.
+  explicit VMPool(std::shared_ptr<const Program> program, unsigned threads = 0);
+  VMPool(const VMPool &) = delete;
+  VMPool &operator=(const VMPool &) = delete;
+  // Runs every call already submitted, then stops the workers.
+  ~VMPool();
+
+  // Queues a call of the function with the given arguments. The result's
+  // status is RuntimeError if there is no such function or the argument count
+  // is wrong.
+  std::future<CallResult> Submit(const char *function_name,
+                                 std::vector<Value> args);
+  std::future<CallResult> Submit(int function, std::vector<Value> args);
+
+  inline size_t get_thread_count() const { return _workers.size(); }
+
+private:
+  struct Job {
+    int function;
+    std::vector<Value> args;
+    std::promise<CallResult> result;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+    std::thread thread;
+  };
+
+  void _run(size_t index);
+  bool _take(size_t index, Job &job);
+
+  std::shared_ptr<const Program> _program;
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::atomic<size_t> _next_worker{0};
+  // submitted jobs not yet taken, only raised under _sleep_mutex so no
+  // wake-up is lost
+  std::atomic<size_t> _pending{0};
+  std::mutex _sleep_mutex;
+  std::condition_variable _wake;
+  bool _stopping = false;
+};
+} // namespace GuiSE
@@ -1,16 +1,21 @@
+#include <guise/compiler/aot.h>
 #include <guise/compiler/compiler.h>
+#include <guise/compiler/module.h>
 #include <guise/vm/byte_code.h>
+#include <guise/vm/image.h>
 #include <guise/vm/vm.h>
 
+#include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 
 using namespace GuiSE;
 
 namespace {
-void repl(VM &vm) {
+void repl(VM &vm, const CompileOptions &options) {
   std::string line;
   for (;;) {
     std::cout << "> ";
@@ -21,34 +26,136 @@ void repl(VM &vm) {
     }
 
     ByteCode byte_code;
-    compile(line.c_str(), byte_code);
+    compile(line.data(), line.size(), byte_code, options);
     vm.set_byte_code(byte_code);
     vm.Run();
     std::cout << std::endl;
   }
 }
 
-void run_file(VM &vm, const char *file_name) {
-  std::ifstream file(file_name);
-  std::stringstream ss;
-  ss << file.rdbuf();
-
+// Returns false if the file could not be loaded or built, or is an image
+// built from sources that have changed since.
+bool run_file(VM &vm, const char *file_name, const ModuleOptions &options) {
   ByteCode byte_code;
-  if (!compile(ss.str().c_str(), byte_code)) {
-    return;
+  if (is_image(file_name)) {
+    uint64_t hash = 0;
+    std::string source_path;
+    if (!load_image(file_name, byte_code, &hash, &source_path)) {
+      std::cerr << "Could not load image " << file_name << "." << std::endl;
+      return false;
+    }
+    // an image shipped without its sources runs as it is
+    std::error_code error;
+    uint64_t current = 0;
+    if (!source_path.empty() && std::filesystem::exists(source_path, error) &&
+        (!hash_modules(source_path, current, options.threads) ||
+         current != hash)) {
+      std::cerr << "Image " << file_name << " is out of date with "
+                << source_path << ", rebuild it with --emit-image."
+                << std::endl;
+      return false;
+    }
+  } else if (!compile_modules(file_name, byte_code, options)) {
+    return false;
   }
   vm.set_byte_code(byte_code);
   vm.RunGlobal();
   vm.Call("main");
+  return true;
+}
+
+bool emit_image(const char *file_name, const char *image_name,
+                const ModuleOptions &options) {
+  ByteCode byte_code;
+  ModuleStats stats;
+  if (!compile_modules(file_name, byte_code, options, &stats)) {
+    return false;
+  }
+
+  // the path is kept absolute so the image can be checked from anywhere
+  std::error_code error;
+  const std::string source_path =
+      std::filesystem::absolute(file_name, error).string();
+  std::ofstream image(image_name, std::ios::binary);
+  if (!write_image(byte_code, stats.source_hash, image, source_path)) {
+    std::cerr << "Could not write image " << image_name << "." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Writes <prefix>.h and <prefix>.cpp, in a namespace named after the last
+// component of prefix.
+bool emit_file(const char *file_name, const std::string &prefix,
+               const ModuleOptions &options) {
+  ByteCode byte_code;
+  if (!compile_modules(file_name, byte_code, options)) {
+    return false;
+  }
+
+  const size_t slash = prefix.find_last_of("/\\");
+  const std::string name =
+      slash == std::string::npos ? prefix : prefix.substr(slash + 1);
+  std::ofstream header(prefix + ".h");
+  std::ofstream source(prefix + ".cpp");
+  if (!emit_cpp(byte_code, name, name + ".h", header, source)) {
+    std::cerr << "Could not translate " << file_name << " to C++." << std::endl;
+    return false;
+  }
+  return true;
 }
 } // namespace
 
 int main(int argc, const char *argv[]) {
+  ModuleOptions options;
+  bool jit = true;
+  const char *emit_prefix = nullptr;
+  const char *image_name = nullptr;
+  const char *file_name = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--peephole") == 0) {
+      options.compile.peephole = true;
+    } else if (strcmp(argv[i], "--no-register-ops") == 0) {
+      options.compile.register_ops = false;
+    } else if (strcmp(argv[i], "--no-fold") == 0) {
+      options.compile.fold_constants = false;
+    } else if (strcmp(argv[i], "--no-jit") == 0) {
+      jit = false;
+    } else if (strcmp(argv[i], "--emit-cpp") == 0 && i + 1 < argc) {
+      emit_prefix = argv[++i];
+    } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+      options.cache_dir = argv[++i];
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      options.threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--emit-image") == 0 && i + 1 < argc) {
+      image_name = argv[++i];
+    } else {
+      file_name = argv[i];
+    }
+  }
+
+  if (emit_prefix != nullptr) {
+    if (file_name == nullptr) {
+      std::cerr << "--emit-cpp needs a script to translate." << std::endl;
+      return 1;
+    }
+    return emit_file(file_name, emit_prefix, options) ? 0 : 1;
+  }
+
+  if (image_name != nullptr) {
+    if (file_name == nullptr) {
+      std::cerr << "--emit-image needs a script to compile." << std::endl;
+      return 1;
+    }
+    return emit_image(file_name, image_name, options) ? 0 : 1;
+  }
+
   VM vm;
-  if (argc == 1) {
-    repl(vm);
-  } else if (argc == 2) {
-    run_file(vm, argv[1]);
+  vm.set_jit_enabled(jit);
+  if (file_name == nullptr) {
+    repl(vm, options.compile);
+  } else if (!run_file(vm, file_name, options)) {
+    return 1;
   }
 
   return 0;
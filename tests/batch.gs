@@ -0,0 +1,336 @@
+# Num and bool functions run over many rows by GuiSE_bench_batch, which
+# checks VM::CallBatch against the interpreter: compares that meet NaNs,
+# >= and <= as !(a < b) and !(a > b), bool lanes, tail calls and locals
+# past 255 reached through Wide.
+
+# NaN where a is infinite
+blend : a num : b num : fn num {
+  return a * 0.0 + b;
+}
+
+atLeast : a num : b num : fn bool {
+  n : num blend a b;
+  return n >= 3.0;
+}
+
+atMost : a num : b num : fn bool {
+  n : num blend a b;
+  return n <= 3.0;
+}
+
+outside : a num : b num : fn bool {
+  n : num blend a b;
+  return n < 2.0 or n > 40.0 and !(n == n) or n != n;
+}
+
+choose : a num : b num : fn bool {
+  return atLeast b a;
+}
+
+scaled : a num : b num : fn num {
+  return blend a b * 2.0;
+}
+
+wide : a num : b num : fn num {
+  l0 : num a;
+  l1 : num l0 + b;
+  l2 : num l1 + b;
+  l3 : num l2 + b;
+  l4 : num l3 + b;
+  l5 : num l4 + b;
+  l6 : num l5 + b;
+  l7 : num l6 + b;
+  l8 : num l7 + b;
+  l9 : num l8 + b;
+  l10 : num l9 + b;
+  l11 : num l10 + b;
+  l12 : num l11 + b;
+  l13 : num l12 + b;
+  l14 : num l13 + b;
+  l15 : num l14 + b;
+  l16 : num l15 + b;
+  l17 : num l16 + b;
+  l18 : num l17 + b;
+  l19 : num l18 + b;
+  l20 : num l19 + b;
+  l21 : num l20 + b;
+  l22 : num l21 + b;
+  l23 : num l22 + b;
+  l24 : num l23 + b;
+  l25 : num l24 + b;
+  l26 : num l25 + b;
+  l27 : num l26 + b;
+  l28 : num l27 + b;
+  l29 : num l28 + b;
+  l30 : num l29 + b;
+  l31 : num l30 + b;
+  l32 : num l31 + b;
+  l33 : num l32 + b;
+  l34 : num l33 + b;
+  l35 : num l34 + b;
+  l36 : num l35 + b;
+  l37 : num l36 + b;
+  l38 : num l37 + b;
+  l39 : num l38 + b;
+  l40 : num l39 + b;
+  l41 : num l40 + b;
+  l42 : num l41 + b;
+  l43 : num l42 + b;
+  l44 : num l43 + b;
+  l45 : num l44 + b;
+  l46 : num l45 + b;
+  l47 : num l46 + b;
+  l48 : num l47 + b;
+  l49 : num l48 + b;
+  l50 : num l49 + b;
+  l51 : num l50 + b;
+  l52 : num l51 + b;
+  l53 : num l52 + b;
+  l54 : num l53 + b;
+  l55 : num l54 + b;
+  l56 : num l55 + b;
+  l57 : num l56 + b;
+  l58 : num l57 + b;
+  l59 : num l58 + b;
+  l60 : num l59 + b;
+  l61 : num l60 + b;
+  l62 : num l61 + b;
+  l63 : num l62 + b;
+  l64 : num l63 + b;
+  l65 : num l64 + b;
+  l66 : num l65 + b;
+  l67 : num l66 + b;
+  l68 : num l67 + b;
+  l69 : num l68 + b;
+  l70 : num l69 + b;
+  l71 : num l70 + b;
+  l72 : num l71 + b;
+  l73 : num l72 + b;
+  l74 : num l73 + b;
+  l75 : num l74 + b;
+  l76 : num l75 + b;
+  l77 : num l76 + b;
+  l78 : num l77 + b;
+  l79 : num l78 + b;
+  l80 : num l79 + b;
+  l81 : num l80 + b;
+  l82 : num l81 + b;
+  l83 : num l82 + b;
+  l84 : num l83 + b;
+  l85 : num l84 + b;
+  l86 : num l85 + b;
+  l87 : num l86 + b;
+  l88 : num l87 + b;
+  l89 : num l88 + b;
+  l90 : num l89 + b;
+  l91 : num l90 + b;
+  l92 : num l91 + b;
+  l93 : num l92 + b;
+  l94 : num l93 + b;
+  l95 : num l94 + b;
+  l96 : num l95 + b;
+  l97 : num l96 + b;
+  l98 : num l97 + b;
+  l99 : num l98 + b;
+  l100 : num l99 + b;
+  l101 : num l100 + b;
+  l102 : num l101 + b;
+  l103 : num l102 + b;
+  l104 : num l103 + b;
+  l105 : num l104 + b;
+  l106 : num l105 + b;
+  l107 : num l106 + b;
+  l108 : num l107 + b;
+  l109 : num l108 + b;
+  l110 : num l109 + b;
+  l111 : num l110 + b;
+  l112 : num l111 + b;
+  l113 : num l112 + b;
+  l114 : num l113 + b;
+  l115 : num l114 + b;
+  l116 : num l115 + b;
+  l117 : num l116 + b;
+  l118 : num l117 + b;
+  l119 : num l118 + b;
+  l120 : num l119 + b;
+  l121 : num l120 + b;
+  l122 : num l121 + b;
+  l123 : num l122 + b;
+  l124 : num l123 + b;
+  l125 : num l124 + b;
+  l126 : num l125 + b;
+  l127 : num l126 + b;
+  l128 : num l127 + b;
+  l129 : num l128 + b;
+  l130 : num l129 + b;
+  l131 : num l130 + b;
+  l132 : num l131 + b;
+  l133 : num l132 + b;
+  l134 : num l133 + b;
+  l135 : num l134 + b;
+  l136 : num l135 + b;
+  l137 : num l136 + b;
+  l138 : num l137 + b;
+  l139 : num l138 + b;
+  l140 : num l139 + b;
+  l141 : num l140 + b;
+  l142 : num l141 + b;
+  l143 : num l142 + b;
+  l144 : num l143 + b;
+  l145 : num l144 + b;
+  l146 : num l145 + b;
+  l147 : num l146 + b;
+  l148 : num l147 + b;
+  l149 : num l148 + b;
+  l150 : num l149 + b;
+  l151 : num l150 + b;
+  l152 : num l151 + b;
+  l153 : num l152 + b;
+  l154 : num l153 + b;
+  l155 : num l154 + b;
+  l156 : num l155 + b;
+  l157 : num l156 + b;
+  l158 : num l157 + b;
+  l159 : num l158 + b;
+  l160 : num l159 + b;
+  l161 : num l160 + b;
+  l162 : num l161 + b;
+  l163 : num l162 + b;
+  l164 : num l163 + b;
+  l165 : num l164 + b;
+  l166 : num l165 + b;
+  l167 : num l166 + b;
+  l168 : num l167 + b;
+  l169 : num l168 + b;
+  l170 : num l169 + b;
+  l171 : num l170 + b;
+  l172 : num l171 + b;
+  l173 : num l172 + b;
+  l174 : num l173 + b;
+  l175 : num l174 + b;
+  l176 : num l175 + b;
+  l177 : num l176 + b;
+  l178 : num l177 + b;
+  l179 : num l178 + b;
+  l180 : num l179 + b;
+  l181 : num l180 + b;
+  l182 : num l181 + b;
+  l183 : num l182 + b;
+  l184 : num l183 + b;
+  l185 : num l184 + b;
+  l186 : num l185 + b;
+  l187 : num l186 + b;
+  l188 : num l187 + b;
+  l189 : num l188 + b;
+  l190 : num l189 + b;
+  l191 : num l190 + b;
+  l192 : num l191 + b;
+  l193 : num l192 + b;
+  l194 : num l193 + b;
+  l195 : num l194 + b;
+  l196 : num l195 + b;
+  l197 : num l196 + b;
+  l198 : num l197 + b;
+  l199 : num l198 + b;
+  l200 : num l199 + b;
+  l201 : num l200 + b;
+  l202 : num l201 + b;
+  l203 : num l202 + b;
+  l204 : num l203 + b;
+  l205 : num l204 + b;
+  l206 : num l205 + b;
+  l207 : num l206 + b;
+  l208 : num l207 + b;
+  l209 : num l208 + b;
+  l210 : num l209 + b;
+  l211 : num l210 + b;
+  l212 : num l211 + b;
+  l213 : num l212 + b;
+  l214 : num l213 + b;
+  l215 : num l214 + b;
+  l216 : num l215 + b;
+  l217 : num l216 + b;
+  l218 : num l217 + b;
+  l219 : num l218 + b;
+  l220 : num l219 + b;
+  l221 : num l220 + b;
+  l222 : num l221 + b;
+  l223 : num l222 + b;
+  l224 : num l223 + b;
+  l225 : num l224 + b;
+  l226 : num l225 + b;
+  l227 : num l226 + b;
+  l228 : num l227 + b;
+  l229 : num l228 + b;
+  l230 : num l229 + b;
+  l231 : num l230 + b;
+  l232 : num l231 + b;
+  l233 : num l232 + b;
+  l234 : num l233 + b;
+  l235 : num l234 + b;
+  l236 : num l235 + b;
+  l237 : num l236 + b;
+  l238 : num l237 + b;
+  l239 : num l238 + b;
+  l240 : num l239 + b;
+  l241 : num l240 + b;
+  l242 : num l241 + b;
+  l243 : num l242 + b;
+  l244 : num l243 + b;
+  l245 : num l244 + b;
+  l246 : num l245 + b;
+  l247 : num l246 + b;
+  l248 : num l247 + b;
+  l249 : num l248 + b;
+  l250 : num l249 + b;
+  l251 : num l250 + b;
+  l252 : num l251 + b;
+  l253 : num l252 + b;
+  l254 : num l253 + b;
+  l255 : num l254 + b;
+  l256 : num l255 + b;
+  l257 : num l256 + b;
+  l258 : num l257 + b;
+  l259 : num l258 + b;
+  l260 : num l259 + b;
+  l261 : num l260 + b;
+  l262 : num l261 + b;
+  l263 : num l262 + b;
+  l264 : num l263 + b;
+  l265 : num l264 + b;
+  l266 : num l265 + b;
+  l267 : num l266 + b;
+  l268 : num l267 + b;
+  l269 : num l268 + b;
+  l270 : num l269 + b;
+  l271 : num l270 + b;
+  l272 : num l271 + b;
+  l273 : num l272 + b;
+  l274 : num l273 + b;
+  l275 : num l274 + b;
+  l276 : num l275 + b;
+  l277 : num l276 + b;
+  l278 : num l277 + b;
+  l279 : num l278 + b;
+  l280 : num l279 + b;
+  l281 : num l280 + b;
+  l282 : num l281 + b;
+  l283 : num l282 + b;
+  l284 : num l283 + b;
+  l285 : num l284 + b;
+  l286 : num l285 + b;
+  l287 : num l286 + b;
+  l288 : num l287 + b;
+  l289 : num l288 + b;
+  l290 : num l289 + b;
+  l291 : num l290 + b;
+  l292 : num l291 + b;
+  l293 : num l292 + b;
+  l294 : num l293 + b;
+  l295 : num l294 + b;
+  l296 : num l295 + b;
+  l297 : num l296 + b;
+  l298 : num l297 + b;
+  l299 : num l298 + b;
+  return l299 * l150 - l0;
+}
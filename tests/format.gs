@@ -0,0 +1,27 @@
+# Format strings, whose slots must print as log does, including nested ones.
+
+label : str "fps";
+
+div : a num : b num : fn num {
+  return a / b;
+}
+
+main : fn {
+  mz : num -0.0;
+  big : num 1000000.0;
+  nan : num div 0.0 0.0;
+  inf : num div 1.0 0.0;
+  log fn "{mz} {big} {nan} {inf} {big > 1.0} {label}";
+  log "|";
+  log mz;
+  log " ";
+  log big;
+  log " ";
+  log nan;
+  log " ";
+  log inf;
+  log "|";
+  log fn "a {fn "b {big / 4.0}"} c";
+  log "|";
+  log fn "[{fn "{mz < 0.0}/{fn "{inf}"}"}]";
+}
@@ -0,0 +1,77 @@
+// Regression check for the collector: a str interned before a cycle and
+// found again by NewStr while the cycle is sweeping must survive it.
+
+#include <guise/compiler/compiler.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/heap.h>
+#include <guise/vm/object.h>
+#include <guise/vm/vm.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+using namespace GuiSE;
+
+namespace {
+const char *source = "s : str \"\";\n"
+                     "set : x num : fn {\n"
+                     "  s = fn \"v={x}\";\n"
+                     "}\n"
+                     "get : fn str {\n"
+                     "  return s;\n"
+                     "}\n";
+
+bool call(VM &vm, int function, Value arg, Value &result) {
+  return vm.Call(function, &arg, 1, result) == InterpretResult::Ok;
+}
+} // namespace
+
+int main() {
+  ByteCode byte_code;
+  if (!compile(source, byte_code))
+    return 1;
+  VM vm;
+  vm.set_byte_code(byte_code);
+  vm.RunGlobal();
+
+  const int set = byte_code.FindFunction("set");
+  const int get = byte_code.FindFunction("get");
+  Value result;
+  // "v=1" is garbage once s moves on to "v=2"
+  if (!call(vm, set, Num(1), result) || !call(vm, set, Num(2), result))
+    return 1;
+
+  // enough junk to start a cycle, whose debt lets the first step finish
+  // marking and sweep part way, newest objects first
+  Heap &heap = vm.get_heap();
+  char chars[32];
+  for (int i = 0; i < 60000; i++) {
+    const int length = snprintf(chars, sizeof(chars), "junk %d", i);
+    heap.NewStr(chars, length);
+  }
+  vm.CollectStep(2);
+  if (heap.get_phase() != GcPhase::Sweep) {
+    printf("expected the cycle to be sweeping\n");
+    return 1;
+  }
+
+  // finds the unswept "v=1" again, then the cycle finishes
+  if (!call(vm, set, Num(1), result))
+    return 1;
+  while (vm.CollectStep(SIZE_MAX)) {
+  }
+  for (int i = 3; i <= 9; i++) {
+    const int length = snprintf(chars, sizeof(chars), "w=%d", i);
+    heap.NewStr(chars, length);
+  }
+
+  if (!call(vm, get, Value(), result))
+    return 1;
+  if (strcmp(result.str->get_chars(), "v=1") != 0) {
+    printf("s is \"%s\", expected \"v=1\"\n", result.str->get_chars());
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
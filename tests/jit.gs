@@ -0,0 +1,352 @@
+# Num and bool functions the JIT compiles, logged the same way with and
+# without --no-jit: NaN compares, tail calls, locals past 255 reached
+# through Wide, and small number literals pushed with PushSmallNum.
+
+nan : z num : fn num {
+  return z / z;
+}
+
+ordered : x num : fn bool {
+  n : num nan x;
+  return n < 1.0 or n > 1.0 or n <= 1.0 or n >= 1.0 or n == n;
+}
+
+unordered : x num : fn bool {
+  n : num nan x;
+  return n != n and !(n < 1.0) and !(n >= 1.0);
+}
+
+half : x num : fn num {
+  return x / 2.0;
+}
+
+twice : x num : fn num {
+  return half x * 4.0;
+}
+
+chain : x num : fn num {
+  return twice x + 1.0;
+}
+
+small : x num : fn num {
+  a : num 3.0;
+  b : num 100.0;
+  c : num 0.5;
+  return x * a + b - c;
+}
+
+wide : x num : fn num {
+  l0 : num x;
+  l1 : num l0 + 1.0;
+  l2 : num l1 + 1.0;
+  l3 : num l2 + 1.0;
+  l4 : num l3 + 1.0;
+  l5 : num l4 + 1.0;
+  l6 : num l5 + 1.0;
+  l7 : num l6 + 1.0;
+  l8 : num l7 + 1.0;
+  l9 : num l8 + 1.0;
+  l10 : num l9 + 1.0;
+  l11 : num l10 + 1.0;
+  l12 : num l11 + 1.0;
+  l13 : num l12 + 1.0;
+  l14 : num l13 + 1.0;
+  l15 : num l14 + 1.0;
+  l16 : num l15 + 1.0;
+  l17 : num l16 + 1.0;
+  l18 : num l17 + 1.0;
+  l19 : num l18 + 1.0;
+  l20 : num l19 + 1.0;
+  l21 : num l20 + 1.0;
+  l22 : num l21 + 1.0;
+  l23 : num l22 + 1.0;
+  l24 : num l23 + 1.0;
+  l25 : num l24 + 1.0;
+  l26 : num l25 + 1.0;
+  l27 : num l26 + 1.0;
+  l28 : num l27 + 1.0;
+  l29 : num l28 + 1.0;
+  l30 : num l29 + 1.0;
+  l31 : num l30 + 1.0;
+  l32 : num l31 + 1.0;
+  l33 : num l32 + 1.0;
+  l34 : num l33 + 1.0;
+  l35 : num l34 + 1.0;
+  l36 : num l35 + 1.0;
+  l37 : num l36 + 1.0;
+  l38 : num l37 + 1.0;
+  l39 : num l38 + 1.0;
+  l40 : num l39 + 1.0;
+  l41 : num l40 + 1.0;
+  l42 : num l41 + 1.0;
+  l43 : num l42 + 1.0;
+  l44 : num l43 + 1.0;
+  l45 : num l44 + 1.0;
+  l46 : num l45 + 1.0;
+  l47 : num l46 + 1.0;
+  l48 : num l47 + 1.0;
+  l49 : num l48 + 1.0;
+  l50 : num l49 + 1.0;
+  l51 : num l50 + 1.0;
+  l52 : num l51 + 1.0;
+  l53 : num l52 + 1.0;
+  l54 : num l53 + 1.0;
+  l55 : num l54 + 1.0;
+  l56 : num l55 + 1.0;
+  l57 : num l56 + 1.0;
+  l58 : num l57 + 1.0;
+  l59 : num l58 + 1.0;
+  l60 : num l59 + 1.0;
+  l61 : num l60 + 1.0;
+  l62 : num l61 + 1.0;
+  l63 : num l62 + 1.0;
+  l64 : num l63 + 1.0;
+  l65 : num l64 + 1.0;
+  l66 : num l65 + 1.0;
+  l67 : num l66 + 1.0;
+  l68 : num l67 + 1.0;
+  l69 : num l68 + 1.0;
+  l70 : num l69 + 1.0;
+  l71 : num l70 + 1.0;
+  l72 : num l71 + 1.0;
+  l73 : num l72 + 1.0;
+  l74 : num l73 + 1.0;
+  l75 : num l74 + 1.0;
+  l76 : num l75 + 1.0;
+  l77 : num l76 + 1.0;
+  l78 : num l77 + 1.0;
+  l79 : num l78 + 1.0;
+  l80 : num l79 + 1.0;
+  l81 : num l80 + 1.0;
+  l82 : num l81 + 1.0;
+  l83 : num l82 + 1.0;
+  l84 : num l83 + 1.0;
+  l85 : num l84 + 1.0;
+  l86 : num l85 + 1.0;
+  l87 : num l86 + 1.0;
+  l88 : num l87 + 1.0;
+  l89 : num l88 + 1.0;
+  l90 : num l89 + 1.0;
+  l91 : num l90 + 1.0;
+  l92 : num l91 + 1.0;
+  l93 : num l92 + 1.0;
+  l94 : num l93 + 1.0;
+  l95 : num l94 + 1.0;
+  l96 : num l95 + 1.0;
+  l97 : num l96 + 1.0;
+  l98 : num l97 + 1.0;
+  l99 : num l98 + 1.0;
+  l100 : num l99 + 1.0;
+  l101 : num l100 + 1.0;
+  l102 : num l101 + 1.0;
+  l103 : num l102 + 1.0;
+  l104 : num l103 + 1.0;
+  l105 : num l104 + 1.0;
+  l106 : num l105 + 1.0;
+  l107 : num l106 + 1.0;
+  l108 : num l107 + 1.0;
+  l109 : num l108 + 1.0;
+  l110 : num l109 + 1.0;
+  l111 : num l110 + 1.0;
+  l112 : num l111 + 1.0;
+  l113 : num l112 + 1.0;
+  l114 : num l113 + 1.0;
+  l115 : num l114 + 1.0;
+  l116 : num l115 + 1.0;
+  l117 : num l116 + 1.0;
+  l118 : num l117 + 1.0;
+  l119 : num l118 + 1.0;
+  l120 : num l119 + 1.0;
+  l121 : num l120 + 1.0;
+  l122 : num l121 + 1.0;
+  l123 : num l122 + 1.0;
+  l124 : num l123 + 1.0;
+  l125 : num l124 + 1.0;
+  l126 : num l125 + 1.0;
+  l127 : num l126 + 1.0;
+  l128 : num l127 + 1.0;
+  l129 : num l128 + 1.0;
+  l130 : num l129 + 1.0;
+  l131 : num l130 + 1.0;
+  l132 : num l131 + 1.0;
+  l133 : num l132 + 1.0;
+  l134 : num l133 + 1.0;
+  l135 : num l134 + 1.0;
+  l136 : num l135 + 1.0;
+  l137 : num l136 + 1.0;
+  l138 : num l137 + 1.0;
+  l139 : num l138 + 1.0;
+  l140 : num l139 + 1.0;
+  l141 : num l140 + 1.0;
+  l142 : num l141 + 1.0;
+  l143 : num l142 + 1.0;
+  l144 : num l143 + 1.0;
+  l145 : num l144 + 1.0;
+  l146 : num l145 + 1.0;
+  l147 : num l146 + 1.0;
+  l148 : num l147 + 1.0;
+  l149 : num l148 + 1.0;
+  l150 : num l149 + 1.0;
+  l151 : num l150 + 1.0;
+  l152 : num l151 + 1.0;
+  l153 : num l152 + 1.0;
+  l154 : num l153 + 1.0;
+  l155 : num l154 + 1.0;
+  l156 : num l155 + 1.0;
+  l157 : num l156 + 1.0;
+  l158 : num l157 + 1.0;
+  l159 : num l158 + 1.0;
+  l160 : num l159 + 1.0;
+  l161 : num l160 + 1.0;
+  l162 : num l161 + 1.0;
+  l163 : num l162 + 1.0;
+  l164 : num l163 + 1.0;
+  l165 : num l164 + 1.0;
+  l166 : num l165 + 1.0;
+  l167 : num l166 + 1.0;
+  l168 : num l167 + 1.0;
+  l169 : num l168 + 1.0;
+  l170 : num l169 + 1.0;
+  l171 : num l170 + 1.0;
+  l172 : num l171 + 1.0;
+  l173 : num l172 + 1.0;
+  l174 : num l173 + 1.0;
+  l175 : num l174 + 1.0;
+  l176 : num l175 + 1.0;
+  l177 : num l176 + 1.0;
+  l178 : num l177 + 1.0;
+  l179 : num l178 + 1.0;
+  l180 : num l179 + 1.0;
+  l181 : num l180 + 1.0;
+  l182 : num l181 + 1.0;
+  l183 : num l182 + 1.0;
+  l184 : num l183 + 1.0;
+  l185 : num l184 + 1.0;
+  l186 : num l185 + 1.0;
+  l187 : num l186 + 1.0;
+  l188 : num l187 + 1.0;
+  l189 : num l188 + 1.0;
+  l190 : num l189 + 1.0;
+  l191 : num l190 + 1.0;
+  l192 : num l191 + 1.0;
+  l193 : num l192 + 1.0;
+  l194 : num l193 + 1.0;
+  l195 : num l194 + 1.0;
+  l196 : num l195 + 1.0;
+  l197 : num l196 + 1.0;
+  l198 : num l197 + 1.0;
+  l199 : num l198 + 1.0;
+  l200 : num l199 + 1.0;
+  l201 : num l200 + 1.0;
+  l202 : num l201 + 1.0;
+  l203 : num l202 + 1.0;
+  l204 : num l203 + 1.0;
+  l205 : num l204 + 1.0;
+  l206 : num l205 + 1.0;
+  l207 : num l206 + 1.0;
+  l208 : num l207 + 1.0;
+  l209 : num l208 + 1.0;
+  l210 : num l209 + 1.0;
+  l211 : num l210 + 1.0;
+  l212 : num l211 + 1.0;
+  l213 : num l212 + 1.0;
+  l214 : num l213 + 1.0;
+  l215 : num l214 + 1.0;
+  l216 : num l215 + 1.0;
+  l217 : num l216 + 1.0;
+  l218 : num l217 + 1.0;
+  l219 : num l218 + 1.0;
+  l220 : num l219 + 1.0;
+  l221 : num l220 + 1.0;
+  l222 : num l221 + 1.0;
+  l223 : num l222 + 1.0;
+  l224 : num l223 + 1.0;
+  l225 : num l224 + 1.0;
+  l226 : num l225 + 1.0;
+  l227 : num l226 + 1.0;
+  l228 : num l227 + 1.0;
+  l229 : num l228 + 1.0;
+  l230 : num l229 + 1.0;
+  l231 : num l230 + 1.0;
+  l232 : num l231 + 1.0;
+  l233 : num l232 + 1.0;
+  l234 : num l233 + 1.0;
+  l235 : num l234 + 1.0;
+  l236 : num l235 + 1.0;
+  l237 : num l236 + 1.0;
+  l238 : num l237 + 1.0;
+  l239 : num l238 + 1.0;
+  l240 : num l239 + 1.0;
+  l241 : num l240 + 1.0;
+  l242 : num l241 + 1.0;
+  l243 : num l242 + 1.0;
+  l244 : num l243 + 1.0;
+  l245 : num l244 + 1.0;
+  l246 : num l245 + 1.0;
+  l247 : num l246 + 1.0;
+  l248 : num l247 + 1.0;
+  l249 : num l248 + 1.0;
+  l250 : num l249 + 1.0;
+  l251 : num l250 + 1.0;
+  l252 : num l251 + 1.0;
+  l253 : num l252 + 1.0;
+  l254 : num l253 + 1.0;
+  l255 : num l254 + 1.0;
+  l256 : num l255 + 1.0;
+  l257 : num l256 + 1.0;
+  l258 : num l257 + 1.0;
+  l259 : num l258 + 1.0;
+  l260 : num l259 + 1.0;
+  l261 : num l260 + 1.0;
+  l262 : num l261 + 1.0;
+  l263 : num l262 + 1.0;
+  l264 : num l263 + 1.0;
+  l265 : num l264 + 1.0;
+  l266 : num l265 + 1.0;
+  l267 : num l266 + 1.0;
+  l268 : num l267 + 1.0;
+  l269 : num l268 + 1.0;
+  l270 : num l269 + 1.0;
+  l271 : num l270 + 1.0;
+  l272 : num l271 + 1.0;
+  l273 : num l272 + 1.0;
+  l274 : num l273 + 1.0;
+  l275 : num l274 + 1.0;
+  l276 : num l275 + 1.0;
+  l277 : num l276 + 1.0;
+  l278 : num l277 + 1.0;
+  l279 : num l278 + 1.0;
+  l280 : num l279 + 1.0;
+  l281 : num l280 + 1.0;
+  l282 : num l281 + 1.0;
+  l283 : num l282 + 1.0;
+  l284 : num l283 + 1.0;
+  l285 : num l284 + 1.0;
+  l286 : num l285 + 1.0;
+  l287 : num l286 + 1.0;
+  l288 : num l287 + 1.0;
+  l289 : num l288 + 1.0;
+  l290 : num l289 + 1.0;
+  l291 : num l290 + 1.0;
+  l292 : num l291 + 1.0;
+  l293 : num l292 + 1.0;
+  l294 : num l293 + 1.0;
+  l295 : num l294 + 1.0;
+  l296 : num l295 + 1.0;
+  l297 : num l296 + 1.0;
+  l298 : num l297 + 1.0;
+  l299 : num l298 + 1.0;
+  return l299 * l150 - l0;
+}
+
+main : fn {
+  log ordered 0.0;
+  log " ";
+  log unordered 0.0;
+  log " ";
+  log chain 5.0;
+  log " ";
+  log small 2.0;
+  log " ";
+  log wide 1.5;
+}
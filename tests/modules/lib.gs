@@ -0,0 +1,6 @@
+# count is private to this module
+count : num 10.0;
+bump : fn num {
+  count = count + 1.0;
+  return count;
+}
@@ -0,0 +1,7 @@
+# declares a global of the same name as one in lib.gs, which stays private
+import "lib.gs";
+count : num 1.0;
+main : fn {
+  log bump;
+  log count;
+}
@@ -0,0 +1,134 @@
+// Stress check for VMPool: many calls spread over several workers, some of
+// them stolen, must give the same results as one VM making the same calls.
+// The str calls make enough garbage for every worker to collect along the
+// way.
+// Build with -fsanitize=thread to check the pool for data races as well.
+
+#include <guise/compiler/compiler.h>
+#include <guise/vm/byte_code.h>
+#include <guise/vm/object.h>
+#include <guise/vm/program.h>
+#include <guise/vm/vm.h>
+#include <guise/vm/vm_pool.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace GuiSE;
+
+namespace {
+// memo results and a global per worker, neither of which may leak between
+// workers or change the results
+const char *source = "scale : num 1.5;\n"
+                     "area : w num : h num : memo fn num {\n"
+                     "  return w * h * scale;\n"
+                     "}\n"
+                     "step : a num : b num : fn num {\n"
+                     "  return a * b + a / b - b * 0.5;\n"
+                     "}\n"
+                     "session : x num : y num : fn num {\n"
+                     "  x = step x y + area x 2.0;\n"
+                     "  y = step y x / 3.5;\n"
+                     "  return x + y;\n"
+                     "}\n"
+                     "label : n num : fn str {\n"
+                     "  return fn \"label {n} of a frame, wide enough that "
+                     "several thousand of them outgrow the heap of a worker "
+                     "{n * 2.0}\";\n"
+                     "}\n";
+} // namespace
+
+int main(int argc, const char *argv[]) {
+  const int calls = argc > 1 ? atoi(argv[1]) : 20000;
+  const unsigned threads = argc > 2 ? atoi(argv[2]) : 8;
+
+  ByteCode byte_code;
+  if (!compile(source, byte_code))
+    return 1;
+  auto program = std::make_shared<const Program>(std::move(byte_code));
+  const int session = program->get_byte_code().FindFunction("session");
+  const int label = program->get_byte_code().FindFunction("label");
+
+  std::vector<Num> expected(calls);
+  {
+    VM vm;
+    vm.set_program(program);
+    vm.RunGlobal();
+    for (int i = 0; i < calls; i++) {
+      const Value args[] = {Num(i % 97 * 0.25), Num(1.5 + i % 13)};
+      Value result;
+      if (vm.Call(session, args, 2, result) != InterpretResult::Ok)
+        return 1;
+      expected[i] = result.num;
+    }
+  }
+  std::vector<std::string> expected_labels(calls * 5);
+  {
+    VM vm;
+    vm.set_program(program);
+    vm.RunGlobal();
+    for (size_t i = 0; i < expected_labels.size(); i++) {
+      const Value arg = Num(i);
+      Value result;
+      if (vm.Call(label, &arg, 1, result) != InterpretResult::Ok)
+        return 1;
+      expected_labels[i].assign(result.str->get_chars(),
+                                result.str->get_length());
+      vm.CollectStep();
+    }
+  }
+
+  int failures = 0;
+  {
+    VMPool pool(program, threads);
+    std::vector<std::future<CallResult>> results;
+    results.reserve(calls);
+    for (int i = 0; i < calls; i++) {
+      results.push_back(
+          pool.Submit(session, {Num(i % 97 * 0.25), Num(1.5 + i % 13)}));
+    }
+    for (int i = 0; i < calls; i++) {
+      const CallResult result = results[i].get();
+      if (result.status != InterpretResult::Ok ||
+          memcmp(&result.value.num, &expected[i], sizeof(Num)) != 0)
+        failures++;
+    }
+
+    std::vector<std::future<CallResult>> labels;
+    labels.reserve(expected_labels.size());
+    for (size_t i = 0; i < expected_labels.size(); i++) {
+      labels.push_back(pool.Submit(label, {Num(i)}));
+    }
+    for (size_t i = 0; i < expected_labels.size(); i++) {
+      const CallResult result = labels[i].get();
+      if (result.status != InterpretResult::Ok ||
+          result.str != expected_labels[i])
+        failures++;
+    }
+
+    const int count =
+        static_cast<int>(program->get_byte_code().FunctionCount());
+    for (const int function : {-1, count, count + 100}) {
+      if (pool.Submit(function, {}).get().status !=
+          InterpretResult::RuntimeError)
+        failures++;
+    }
+    if (pool.Submit("missing", {}).get().status !=
+            InterpretResult::RuntimeError ||
+        pool.Submit(session, {Num(1)}).get().status !=
+            InterpretResult::RuntimeError)
+      failures++;
+  }
+
+  if (failures != 0) {
+    printf("%d calls differ from one VM\n", failures);
+    return 1;
+  }
+  printf("ok, %d calls on %u threads\n", calls, threads);
+  return 0;
+}